@@ -0,0 +1,334 @@
+/**
+ * alu_tables_test - check the ALU lookup tables (alu_tables.hpp) and the
+ * instructions that use them against reference versions of the 8-bit ALU,
+ * written out bit by bit like the handlers were before the tables:
+ *
+ *   tables    every entry of ADD_FLAGS, SUB_FLAGS, INC_FLAGS, DEC_FLAGS,
+ *             DAA_TABLE and SHIFT_TABLE
+ *   handlers  ADD, ADC, SUB, SBC and CP (register, (HL) and immediate
+ *             forms), INC and DEC, DAA, RLCA/RRCA/RLA/RRA and CB 00-3F
+ *             (on B, A and (HL)), run through CPU::execute_instruction
+ *             for every operand value and all 16 Z/N/H/C states; A (or
+ *             the target) and F must match the reference
+ *
+ * Exits non-zero if anything differs.
+ *
+ * Usage: alu_tables_test
+ */
+
+#include <iostream>
+
+#include "../include/alu_tables.hpp"
+#include "machine.hpp"
+
+// Mismatches printed in full before only counting the rest
+static const int MAX_REPORTS = 10;
+
+// Where (HL) points during the handler checks
+static const uint16_t HL_ADDRESS = 0xC000;
+
+// A result byte and the F it leaves
+struct AluResult {
+    uint8_t value;
+    uint8_t f;
+};
+
+static uint8_t make_f(bool z, bool n, bool h, bool c) {
+    return (z << Z_FLAG_BIT) | (n << N_FLAG_BIT) | (h << H_FLAG_BIT) | (c << C_FLAG_BIT);
+}
+
+static bool flag(uint8_t f, int bit) {
+    return (f >> bit) & 1;
+}
+
+// Reference ALU
+
+static AluResult reference_add(uint8_t a, uint8_t b, bool carry) {
+    uint16_t result = a + b + carry;
+    bool half = (a & 0x0F) + (b & 0x0F) + carry > 0x0F;
+    return {static_cast<uint8_t>(result), make_f(static_cast<uint8_t>(result) == 0, false, half, result > 0xFF)};
+}
+
+static AluResult reference_sub(uint8_t a, uint8_t b, bool carry) {
+    uint8_t result = a - b - carry;
+    bool half = (a & 0x0F) < (b & 0x0F) + carry;
+    return {result, make_f(result == 0, true, half, a < b + carry)};
+}
+
+// C is passed through from f
+static AluResult reference_inc(uint8_t value, uint8_t f) {
+    uint8_t result = value + 1;
+    return {result, make_f(result == 0, false, ((value & 0x0F) + 1) > 0x0F, flag(f, C_FLAG_BIT))};
+}
+
+static AluResult reference_dec(uint8_t value, uint8_t f) {
+    uint8_t result = value - 1;
+    return {result, make_f(result == 0, true, (value & 0x0F) == 0x00, flag(f, C_FLAG_BIT))};
+}
+
+static AluResult reference_daa(uint8_t a, uint8_t f) {
+    bool n = flag(f, N_FLAG_BIT);
+    bool h = flag(f, H_FLAG_BIT);
+    bool c = flag(f, C_FLAG_BIT);
+    uint8_t correction = 0;
+    bool carry = false;
+    if (n) {
+        if (c) {
+            correction |= 0x60;
+            carry = true;
+        }
+        if (h) {
+            correction |= 0x06;
+        }
+        a -= correction;
+    } else {
+        if (h || (a & 0x0F) > 0x09) {
+            correction |= 0x06;
+        }
+        if (c || a > 0x99) {
+            correction |= 0x60;
+            carry = true;
+        }
+        a += correction;
+    }
+    return {a, make_f(a == 0, n, false, carry)};
+}
+
+// A ShiftOp, as the CB form (Z from the result)
+static AluResult reference_shift(int op, uint8_t value, uint8_t f) {
+    bool carry_in = flag(f, C_FLAG_BIT);
+    uint8_t result = 0;
+    bool carry = false;
+    switch (op) {
+        case SHIFT_RLC: result = (value << 1) | (value >> 7); carry = value & 0x80; break;
+        case SHIFT_RRC: result = (value >> 1) | (value << 7); carry = value & 0x01; break;
+        case SHIFT_RL: result = (value << 1) | carry_in; carry = value & 0x80; break;
+        case SHIFT_RR: result = (value >> 1) | (carry_in << 7); carry = value & 0x01; break;
+        case SHIFT_SLA: result = value << 1; carry = value & 0x80; break;
+        case SHIFT_SRA: result = (value & 0x80) | (value >> 1); carry = value & 0x01; break;
+        case SHIFT_SWAP: result = (value << 4) | (value >> 4); carry = false; break;
+        case SHIFT_SRL: result = value >> 1; carry = value & 0x01; break;
+    }
+    return {result, make_f(result == 0, false, false, carry)};
+}
+
+// Counts and reports mismatches
+struct Checker {
+    const char *section;
+    long checked = 0;
+    long bad = 0;
+
+    explicit Checker(const char *section) : section(section) {}
+
+    // what: a description of the case, printed as hex
+    void expect(bool ok, const char *what, int x, int y, int z, int got, int expected) {
+        checked++;
+        if (ok) {
+            return;
+        }
+        if (bad < MAX_REPORTS) {
+            std::cout << std::hex << section << ": " << what << " " << x << " " << y << " " << z << ": got " << got
+                      << ", expected " << expected << std::dec << "\n";
+        }
+        bad++;
+    }
+
+    bool done() {
+        std::cout << section << ": " << checked << " checked, " << bad << " differ\n";
+        return bad == 0;
+    }
+};
+
+static uint8_t entry_f(uint16_t entry) {
+    return make_f(static_cast<uint8_t>(entry) == 0, false, false, entry & ALU_CARRY);
+}
+
+static bool check_tables() {
+    Checker check("tables");
+    for (int a = 0; a < 256; a++) {
+        for (int b = 0; b < 256; b++) {
+            uint8_t f = reference_add(a, b, false).f;
+            check.expect(ADD_FLAGS.entries[a][b] == f, "ADD_FLAGS", a, b, 0, ADD_FLAGS.entries[a][b], f);
+            f = reference_sub(a, b, false).f;
+            check.expect(SUB_FLAGS.entries[a][b] == f, "SUB_FLAGS", a, b, 0, SUB_FLAGS.entries[a][b], f);
+        }
+
+        // Table entries leave C clear; the handlers keep the old one
+        uint8_t f = reference_inc(a, 0).f;
+        check.expect(INC_FLAGS.entries[a] == f, "INC_FLAGS", a, 0, 0, INC_FLAGS.entries[a], f);
+        f = reference_dec(a, 0).f;
+        check.expect(DEC_FLAGS.entries[a] == f, "DEC_FLAGS", a, 0, 0, DEC_FLAGS.entries[a], f);
+
+        for (int flags = 0; flags < 8; flags++) {
+            AluResult expected = reference_daa(a, make_f(false, flags & 4, flags & 2, flags & 1));
+            uint16_t entry = DAA_TABLE.entries[flags][a];
+            // N is passed through by the handler, so compare Z and C only
+            bool same = static_cast<uint8_t>(entry) == expected.value &&
+                        (entry_f(entry) & ~(1 << N_FLAG_BIT)) == (expected.f & ~(1 << N_FLAG_BIT));
+            check.expect(same, "DAA_TABLE", flags, a, 0, entry, expected.value);
+        }
+
+        for (int op = 0; op < 8; op++) {
+            for (int carry = 0; carry < 2; carry++) {
+                AluResult expected = reference_shift(op, a, make_f(false, false, false, carry));
+                uint16_t entry = SHIFT_TABLE.entries[op][carry][a];
+                bool same = static_cast<uint8_t>(entry) == expected.value && entry_f(entry) == expected.f;
+                check.expect(same, "SHIFT_TABLE", op, carry, a, entry, expected.value);
+            }
+        }
+    }
+    return check.done();
+}
+
+// Where an instruction reads its operand and writes its result
+enum Operand { OPERAND_B, OPERAND_A, OPERAND_HL, OPERAND_IMMEDIATE };
+
+static void set_operand(Machine &m, Operand operand, uint8_t value) {
+    switch (operand) {
+        case OPERAND_B: m.cpu.set_bc(static_cast<uint16_t>(value) << 8); break;
+        case OPERAND_HL: m.bus.write_mem(HL_ADDRESS, value); break;
+        default: break; // A is set with F, the immediate is in the instruction
+    }
+}
+
+static uint8_t get_operand(Machine &m, Operand operand) {
+    switch (operand) {
+        case OPERAND_B: return m.cpu.get_bc() >> 8;
+        case OPERAND_HL: return m.bus.read_mem(HL_ADDRESS);
+        default: return m.cpu.get_af() >> 8;
+    }
+}
+
+// Run one instruction on A = a and F = f, return A (or the operand, for
+// target_is_operand) and F
+static AluResult run(Machine &m, uint32_t instruction, uint8_t a, uint8_t f, Operand operand,
+                     bool target_is_operand) {
+    m.cpu.set_af((static_cast<uint16_t>(a) << 8) | f);
+    m.cpu.execute_instruction(instruction);
+    uint16_t af = m.cpu.get_af();
+    uint8_t value = target_is_operand ? get_operand(m, operand) : static_cast<uint8_t>(af >> 8);
+    return {value, static_cast<uint8_t>(af)};
+}
+
+enum BinaryOp { OP_ADD, OP_ADC, OP_SUB, OP_SBC, OP_CP };
+
+static AluResult reference_binary(BinaryOp op, uint8_t a, uint8_t b, uint8_t f) {
+    bool carry = flag(f, C_FLAG_BIT);
+    switch (op) {
+        case OP_ADD: return reference_add(a, b, false);
+        case OP_ADC: return reference_add(a, b, carry);
+        case OP_SUB: return reference_sub(a, b, false);
+        case OP_SBC: return reference_sub(a, b, carry);
+        default: return {a, reference_sub(a, b, false).f}; // OP_CP leaves A alone
+    }
+}
+
+static void check_binary(Checker &check, Machine &m, BinaryOp op) {
+    // ADD 80, ADC 88, SUB 90, SBC 98, CP B8; C6, CE, D6, DE, FE with an immediate
+    static const uint8_t register_opcodes[] = {0x80, 0x88, 0x90, 0x98, 0xB8};
+    static const uint8_t immediate_opcodes[] = {0xC6, 0xCE, 0xD6, 0xDE, 0xFE};
+    struct Form {
+        uint8_t opcode;
+        Operand operand;
+    } forms[] = {
+        {register_opcodes[op], OPERAND_B},
+        {static_cast<uint8_t>(register_opcodes[op] | 6), OPERAND_HL},
+        {static_cast<uint8_t>(register_opcodes[op] | 7), OPERAND_A},
+        {immediate_opcodes[op], OPERAND_IMMEDIATE},
+    };
+
+    for (const Form &form : forms) {
+        for (int a = 0; a < 256; a++) {
+            for (int b = 0; b < 256; b++) {
+                if (form.operand == OPERAND_A && b != a) {
+                    continue;
+                }
+                set_operand(m, form.operand, b);
+                uint32_t instruction = (static_cast<uint32_t>(form.opcode) << 16) | (b << 8);
+                for (int flags = 0; flags < 16; flags++) {
+                    uint8_t f = flags << 4;
+                    AluResult expected = reference_binary(op, a, b, f);
+                    AluResult got = run(m, instruction, a, f, form.operand, false);
+                    bool same = got.value == expected.value && got.f == expected.f;
+                    check.expect(same, "opcode, A, operand, F", form.opcode, a, b << 8 | f,
+                                 got.value << 8 | got.f, expected.value << 8 | expected.f);
+                }
+            }
+        }
+    }
+}
+
+// INC/DEC r and (HL), DAA, the A rotates and the CB rotates and shifts:
+// one input value plus F
+static void check_unary(Checker &check, Machine &m) {
+    // INC B 04, DEC B 05, INC (HL) 34, DEC (HL) 35, INC A 3C, DEC A 3D
+    struct Form {
+        uint8_t opcode;
+        Operand operand;
+        bool decrement;
+    } inc_dec[] = {
+        {0x04, OPERAND_B, false}, {0x05, OPERAND_B, true}, {0x34, OPERAND_HL, false},
+        {0x35, OPERAND_HL, true}, {0x3C, OPERAND_A, false}, {0x3D, OPERAND_A, true},
+    };
+    // RLCA, RRCA, RLA, RRA
+    const uint8_t a_rotates[] = {0x07, 0x0F, 0x17, 0x1F};
+    const Operand cb_operands[] = {OPERAND_B, OPERAND_HL, OPERAND_A};
+
+    for (int value = 0; value < 256; value++) {
+        for (int flags = 0; flags < 16; flags++) {
+            uint8_t f = flags << 4;
+
+            for (const Form &form : inc_dec) {
+                AluResult expected = form.decrement ? reference_dec(value, f) : reference_inc(value, f);
+                set_operand(m, form.operand, value);
+                AluResult got = run(m, static_cast<uint32_t>(form.opcode) << 16, value, f, form.operand, true);
+                check.expect(got.value == expected.value && got.f == expected.f, "opcode, value, F", form.opcode,
+                             value, f, got.value << 8 | got.f, expected.value << 8 | expected.f);
+            }
+
+            AluResult expected = reference_daa(value, f);
+            AluResult got = run(m, 0x27 << 16, value, f, OPERAND_A, false);
+            check.expect(got.value == expected.value && got.f == expected.f, "DAA, A, F", 0x27, value, f,
+                         got.value << 8 | got.f, expected.value << 8 | expected.f);
+
+            // Same as the CB form on A, except that Z is always reset
+            for (int i = 0; i < 4; i++) {
+                expected = reference_shift(i, value, f);
+                expected.f &= ~(1 << Z_FLAG_BIT);
+                got = run(m, a_rotates[i] << 16, value, f, OPERAND_A, false);
+                check.expect(got.value == expected.value && got.f == expected.f, "opcode, A, F", a_rotates[i],
+                             value, f, got.value << 8 | got.f, expected.value << 8 | expected.f);
+            }
+
+            for (int op = 0; op < 8; op++) {
+                for (Operand operand : cb_operands) {
+                    int target = operand == OPERAND_B ? B_REGISTER : operand == OPERAND_A ? A_REGISTER : 6;
+                    uint8_t cb_opcode = (op << 3) | target;
+                    expected = reference_shift(op, value, f);
+                    set_operand(m, operand, value);
+                    got = run(m, (0xCB << 16) | (cb_opcode << 8), value, f, operand, true);
+                    check.expect(got.value == expected.value && got.f == expected.f, "CB opcode, value, F",
+                                 cb_opcode, value, f, got.value << 8 | got.f, expected.value << 8 | expected.f);
+                }
+            }
+        }
+    }
+}
+
+static bool check_handlers() {
+    Machine *m = new Machine();
+    m->cpu.set_hl(HL_ADDRESS);
+    Checker check("handlers");
+    for (BinaryOp op : {OP_ADD, OP_ADC, OP_SUB, OP_SBC, OP_CP}) {
+        check_binary(check, *m, op);
+    }
+    check_unary(check, *m);
+    delete m;
+    return check.done();
+}
+
+int main() {
+    bool ok = check_tables();
+    ok = check_handlers() && ok;
+    return ok ? 0 : 1;
+}
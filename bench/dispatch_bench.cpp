@@ -0,0 +1,142 @@
+/**
+ * dispatch_bench - compare the per-instruction table dispatch loop with the
+ * threaded CPU::run loop, with and without the basic-block cache.
+ *
+ * Only the CPU core is measured: each ROM runs with the memory system and
+ * interrupt handler wired up, but without the PPU, timer or SDL.
+ *
+ * Usage: dispatch_bench [m_cycles] [rom ...]   (default: every ROM in games/)
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "machine.hpp"
+
+struct RunResult {
+    double seconds;
+    uint64_t cycles;
+    uint16_t pc;
+    bool ok;
+};
+
+static bool load_rom(Bus &bus, const std::string &rom_path) {
+    std::ifstream rom_file(rom_path, std::ios::binary);
+    if (!rom_file.is_open()) {
+        return false;
+    }
+    std::vector<char> buffer((std::istreambuf_iterator<char>(rom_file)), std::istreambuf_iterator<char>());
+    size_t load_size = std::min(buffer.size(), (size_t)0x8000);
+    for (size_t i = 0; i < load_size; ++i) {
+        bus.write_raw(static_cast<uint16_t>(i), static_cast<uint8_t>(buffer[i]));
+    }
+    return load_size > 0;
+}
+
+// One fetch and one table dispatch per iteration
+static RunResult run_step_loop(const std::string &rom_path, uint64_t budget) {
+    Machine *m = new Machine();
+    RunResult result = {0, 0, 0, load_rom(m->bus, rom_path)};
+
+    auto start = std::chrono::steady_clock::now();
+    while (result.ok && m->cpu.get_cycles() < budget) {
+        uint32_t instruction = m->cpu.fetch_instruction();
+        result.ok = m->cpu.execute_instruction(instruction);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    result.seconds = std::chrono::duration<double>(end - start).count();
+    result.cycles = m->cpu.get_cycles();
+    result.pc = m->cpu.get_pc();
+    delete m;
+    return result;
+}
+
+static RunResult run_threaded_loop(const std::string &rom_path, uint64_t budget, bool cached) {
+    Machine *m = new Machine();
+    RunResult result = {0, 0, 0, load_rom(m->bus, rom_path)};
+    if (cached) {
+        m->connect_block_cache();
+    }
+    // Nothing here ever changes what a polling loop reads, so skipping
+    // would jump straight to the budget instead of measuring dispatch
+    m->cpu.skip_idle_loops = false;
+
+    auto start = std::chrono::steady_clock::now();
+    // run() also returns early when interrupts may have become pending
+    while (result.ok && m->cpu.get_cycles() < budget) {
+        result.ok = m->cpu.run(budget);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    result.seconds = std::chrono::duration<double>(end - start).count();
+    result.cycles = m->cpu.get_cycles();
+    result.pc = m->cpu.get_pc();
+    if (cached) {
+        std::cout << "  (" << m->block_cache.blocks_decoded << " blocks decoded, "
+                  << m->block_cache.blocks_invalidated << " invalidated)\n";
+    }
+    delete m;
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t budget = 50000000; // M-cycles per run (~12 emulated seconds)
+    std::vector<std::string> roms;
+
+    if (argc > 1) {
+        budget = std::stoull(argv[1]);
+    }
+    for (int i = 2; i < argc; i++) {
+        roms.push_back(argv[i]);
+    }
+    if (roms.empty()) {
+        for (const auto &entry : std::filesystem::directory_iterator("games")) {
+            if (entry.path().extension() == ".gb") {
+                roms.push_back(entry.path().string());
+            }
+        }
+        std::sort(roms.begin(), roms.end());
+    }
+
+#ifdef CPU_USE_COMPUTED_GOTO
+    const char *threaded_name = "computed goto";
+#else
+    const char *threaded_name = "switch";
+#endif
+    std::cout << "M-cycles per run: " << budget << ", CPU::run dispatch: " << threaded_name << "\n\n";
+
+    int status = 0;
+    for (const std::string &rom : roms) {
+        std::cout << rom << "\n";
+        RunResult step = run_step_loop(rom, budget);
+        RunResult threaded = run_threaded_loop(rom, budget, false);
+        RunResult cached = run_threaded_loop(rom, budget, true);
+
+        if (!step.ok || !threaded.ok || !cached.ok) {
+            std::cerr << rom << ": stopped on an unimplemented opcode or failed to load\n";
+            status = 1;
+        }
+        if (step.cycles != threaded.cycles || step.pc != threaded.pc ||
+            step.cycles != cached.cycles || step.pc != cached.pc) {
+            std::cerr << rom << ": loops diverged (pc " << std::hex << step.pc << " vs " << threaded.pc
+                      << " vs " << cached.pc << std::dec << ")\n";
+            status = 1;
+        }
+
+        double step_rate = step.cycles / step.seconds / 1e6;
+        double threaded_rate = threaded.cycles / threaded.seconds / 1e6;
+        double cached_rate = cached.cycles / cached.seconds / 1e6;
+        std::cout << "  step loop:     " << step_rate << " M-cycles/s\n"
+                  << "  threaded loop: " << threaded_rate << " M-cycles/s ("
+                  << threaded_rate / step_rate << "x)\n"
+                  << "  block cache:   " << cached_rate << " M-cycles/s ("
+                  << cached_rate / step_rate << "x)\n";
+    }
+    return status;
+}
@@ -0,0 +1,136 @@
+/**
+ * interrupt_test - check IE and IF (kept in InterruptHandler since the
+ * pending mask) as the CPU reaches them:
+ *
+ *   registers  every value written to IE and IF through the bus reads
+ *              back (IF with its top three bits set) and gives the
+ *              right pending mask
+ *   stack      PUSH with SP at 0x0000 (the high byte lands in IE) and at
+ *              0xFF11 (the low byte lands in IF), and POP with SP at
+ *              0xFFFE (the high byte comes from IE), run by CPU::run with
+ *              and without the block cache. Each IE or IF write has to end
+ *              the run() slice, like a plain write does, so an interrupt
+ *              it made pending is taken before the next instruction
+ *   dispatch   handle_interrupts takes the lowest pending bit first and
+ *              leaves the others requested
+ *
+ * Exits non-zero if anything differs.
+ *
+ * Usage: interrupt_test
+ */
+
+#include <iostream>
+
+#include "machine.hpp"
+
+struct Checker {
+    const char *section;
+    long checked = 0;
+    long bad = 0;
+
+    explicit Checker(const char *section) : section(section) {}
+
+    void expect(const char *what, int got, int expected) {
+        checked++;
+        if (got == expected) {
+            return;
+        }
+        std::cout << std::hex << section << ": " << what << ": got " << got << ", expected " << expected
+                  << std::dec << "\n";
+        bad++;
+    }
+
+    bool done() {
+        std::cout << section << ": " << checked << " checked, " << bad << " differ\n";
+        return bad == 0;
+    }
+};
+
+static bool check_registers() {
+    Machine *m = new Machine();
+    Checker check("registers");
+    for (int ie = 0; ie < 0x100; ie++) {
+        for (int flags = 0; flags < 0x100; flags++) {
+            m->bus.write_mem(0xFFFF, ie);
+            m->bus.write_mem(0xFF0F, flags);
+            check.expect("IE", m->bus.read_mem(0xFFFF), ie);
+            check.expect("IF", m->bus.read_mem(0xFF0F), flags | 0xE0);
+            check.expect("pending", m->IH.get_pending(), ie & flags & INTERRUPT_MASK);
+        }
+    }
+    delete m;
+    return check.done();
+}
+
+static void check_stack(Checker &check, bool block_cache) {
+    Machine *m = new Machine();
+    m->connect_peripherals();
+    if (block_cache) {
+        m->connect_block_cache();
+    }
+    m->load(0x0100, {
+        0x31, 0x00, 0x00, // LD SP, 0x0000
+        0x01, 0x01, 0x1F, // LD BC, 0x1F01
+        0xC5,             // PUSH BC: IE = 0x1F, (0xFFFE) = 0x01
+        0x31, 0x11, 0xFF, // LD SP, 0xFF11
+        0x11, 0x04, 0x00, // LD DE, 0x0004
+        0xD5,             // PUSH DE: (0xFF10) = 0x00, IF = TIMER
+        0x31, 0xFE, 0xFF, // LD SP, 0xFFFE
+        0xE1,             // POP HL: L = (0xFFFE), H = IE
+        0x18, 0xFE,       // JR -2
+    });
+
+    m->cpu.run(m->cpu.get_cycles() + 1000);
+    check.expect("pc after the push into IE", m->cpu.get_pc(), 0x0107);
+    check.expect("IE", m->IH.get_IE(), 0x1F);
+    check.expect("(0xFFFE)", m->bus.read_mem(0xFFFE), 0x01);
+    check.expect("pending", m->IH.get_pending(), 0);
+
+    m->cpu.run(m->cpu.get_cycles() + 1000);
+    check.expect("pc after the push into IF", m->cpu.get_pc(), 0x010E);
+    check.expect("IF", m->IH.get_IF(), 0xE0 | TIMER_FLAG);
+    check.expect("pending", m->IH.get_pending(), TIMER_FLAG);
+
+    m->cpu.run(m->cpu.get_cycles() + 20);
+    check.expect("HL popped from HRAM and IE", m->cpu.get_hl(), 0x1F01);
+    check.expect("SP after the pop", m->cpu.get_sp(), 0x0000);
+    delete m;
+}
+
+static bool check_dispatch() {
+    Machine *m = new Machine();
+    m->connect_peripherals();
+    Checker check("dispatch");
+    m->load(0x0100, {
+        0x31, 0xF0, 0xDF, // LD SP, 0xDFF0
+        0xFB,             // EI
+        0x00,             // NOP
+        0x18, 0xFE,       // JR -2
+    });
+    m->bus.write_mem(0xFFFF, INTERRUPT_MASK);
+    m->bus.write_mem(0xFF0F, TIMER_FLAG | JOYPAD_FLAG);
+    m->cpu.run(m->cpu.get_cycles() + 20);
+    uint16_t return_pc = m->cpu.get_pc();
+
+    m->cpu.handle_interrupts();
+    check.expect("pc", m->cpu.get_pc(), 0x0050);
+    check.expect("IF left", m->IH.get_IF(), 0xE0 | JOYPAD_FLAG);
+    check.expect("SP", m->cpu.get_sp(), 0xDFEE);
+    check.expect("return address", m->bus.read_mem(0xDFEE) | (m->bus.read_mem(0xDFEF) << 8), return_pc);
+
+    // IME is off in the handler: JOYPAD waits
+    m->cpu.handle_interrupts();
+    check.expect("pc with IME off", m->cpu.get_pc(), 0x0050);
+    delete m;
+    return check.done();
+}
+
+int main() {
+    bool ok = check_registers();
+    Checker stack("stack");
+    check_stack(stack, false);
+    check_stack(stack, true);
+    ok = stack.done() && ok;
+    ok = check_dispatch() && ok;
+    return ok ? 0 : 1;
+}
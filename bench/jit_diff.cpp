@@ -0,0 +1,90 @@
+/**
+ * jit_diff - run a ROM with the JIT in differential mode, so that every
+ * native block run is replayed through the interpreter and compared, then
+ * check that plain interpreter and JIT runs end in the same state and
+ * compare their speed.
+ *
+ * The whole machine runs (PPU, timer and scheduler included, as in the
+ * headless frontend), so that games get past their LY and VBlank waits and
+ * their hot loops get compiled.
+ *
+ * Usage: jit_diff [rom] [m_cycles]   (default: tests/cpu_instrs.gb, 20M)
+ */
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "../include/emulator.hpp"
+
+// Returns false if the run stopped on an unimplemented opcode
+static bool run_machine(Emulator &emu, uint64_t budget, double &seconds) {
+    bool ok = true;
+    auto start = std::chrono::steady_clock::now();
+    while (ok) {
+        emu.service_events();
+        if (emu.cpu.get_cycles() >= budget) {
+            break;
+        }
+        ok = emu.run_cpu();
+    }
+    auto end = std::chrono::steady_clock::now();
+    seconds = std::chrono::duration<double>(end - start).count();
+    return ok;
+}
+
+static bool same_state(Emulator &a, Emulator &b) {
+    return a.cpu.get_cycles() == b.cpu.get_cycles() && a.cpu.get_pc() == b.cpu.get_pc() &&
+           a.bus.same_memory(b.bus) && a.IH.get_IF() == b.IH.get_IF() && a.IH.get_IE() == b.IH.get_IE() &&
+           a.frames == b.frames;
+}
+
+int main(int argc, char *argv[]) {
+    std::string rom = (argc > 1) ? argv[1] : "tests/cpu_instrs.gb";
+    uint64_t budget = (argc > 2) ? std::stoull(argv[2]) : 20000000;
+
+    Emulator *interpreted = new Emulator();
+    Emulator *jitted = new Emulator();
+    Emulator *checked = new Emulator();
+    interpreted->cpu.connect_jit(nullptr);
+    checked->jit.differential = true;
+
+    if (!interpreted->load_rom(rom) || !jitted->load_rom(rom) || !checked->load_rom(rom)) {
+        return 1;
+    }
+
+    double interpreted_seconds, jitted_seconds, checked_seconds;
+    bool interpreted_ok = run_machine(*interpreted, budget, interpreted_seconds);
+    bool jitted_ok = run_machine(*jitted, budget, jitted_seconds);
+    bool checked_ok = run_machine(*checked, budget, checked_seconds);
+
+    int status = 0;
+    std::cout << rom << ", " << budget << " M-cycles, " << interpreted->frames << " frames\n"
+              << "  blocks compiled: " << checked->jit.blocks_compiled
+              << ", native runs checked: " << checked->jit.native_runs
+              << ", mismatches: " << checked->jit.mismatches << "\n";
+    if (checked->jit.mismatches != 0) {
+        status = 1;
+    }
+
+    if (interpreted_ok != jitted_ok || !same_state(*interpreted, *jitted) || !same_state(*interpreted, *checked)) {
+        std::cerr << "  interpreter and JIT runs ended in different states (pc " << std::hex
+                  << interpreted->cpu.get_pc() << " vs " << jitted->cpu.get_pc() << std::dec << ")\n";
+        status = 1;
+    }
+    if (!interpreted_ok || !checked_ok) {
+        std::cout << "  stopped on an unimplemented opcode at pc 0x" << std::hex
+                  << interpreted->cpu.get_pc() << std::dec << "\n";
+    }
+
+    double interpreted_rate = interpreted->cpu.get_cycles() / interpreted_seconds / 1e6;
+    double jitted_rate = jitted->cpu.get_cycles() / jitted_seconds / 1e6;
+    std::cout << "  interpreter: " << interpreted_rate << " M-cycles/s\n"
+              << "  JIT:         " << jitted_rate << " M-cycles/s (" << jitted_rate / interpreted_rate << "x)\n"
+              << (status == 0 ? "OK" : "FAILED") << "\n";
+
+    delete interpreted;
+    delete jitted;
+    delete checked;
+    return status;
+}
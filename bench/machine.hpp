@@ -0,0 +1,60 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+#include "../include/block_cache.hpp"
+#include "../include/bus.hpp"
+#include "../include/cpu.hpp"
+#include "../include/input.hpp"
+#include "../include/InterruptHandler.hpp"
+#include "../include/ppu.hpp"
+#include "../include/scheduler.hpp"
+#include "../include/timer.hpp"
+
+/**
+ * The emulator's components for the bench tools and checks, without SDL
+ * or the Emulator frame loop. The constructor wires the CPU core (bus,
+ * joypad, interrupt handler, CPU) and gives the PPU the bus;
+ * connect_block_cache() and connect_peripherals() add the rest the way
+ * Emulator does.
+ */
+struct Machine {
+    Bus bus;
+    Input input;
+    InterruptHandler IH;
+    BlockCache block_cache;
+    Scheduler scheduler;
+    Timer timer;
+    PPU ppu;
+    CPU cpu;
+
+    Machine() {
+        bus.connect_input(&input);
+        bus.connect_interrupt_handler(&IH);
+        ppu.connect_bus(&bus);
+        cpu.connect_bus(&bus);
+        cpu.connect_interrupt_handler(&IH);
+    }
+
+    void connect_block_cache() {
+        cpu.connect_block_cache(&block_cache);
+        bus.connect_block_cache(&block_cache);
+    }
+
+    // Timer, scheduler and the PPU's interrupts
+    void connect_peripherals() {
+        scheduler.connect_cpu(&cpu);
+        bus.connect_timer(&timer);
+        bus.connect_scheduler(&scheduler);
+        timer.connect_interrupt_handler(&IH);
+        timer.connect_scheduler(&scheduler);
+        ppu.connect_interrupt_handler(&IH);
+        ppu.connect_scheduler(&scheduler);
+    }
+
+    void load(uint16_t addr, const std::vector<uint8_t> &bytes) {
+        for (size_t i = 0; i < bytes.size(); i++) {
+            bus.write_raw(static_cast<uint16_t>(addr + i), bytes[i]);
+        }
+    }
+};
@@ -0,0 +1,371 @@
+/**
+ * micro_bench - microbenchmarks for the individual hot paths: bus reads and
+ * writes per memory region, stack traffic, CPU fetch, dispatch, ALU and
+ * shifts, the PPU scanline renderers and pixel kernels, OAM DMA and
+ * interrupt polling. Each case prints a rate so runs can be compared before
+ * and after a change, and a regression can be pinned on one subsystem.
+ *
+ * Memory, VRAM and OAM contents are synthetic and fixed (see
+ * fill_video), so the numbers are repeatable. Every pixel kernel
+ * version the host can run is checked against the scalar one first.
+ *
+ * Usage: micro_bench
+ */
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../include/pixel_kernels.hpp"
+#include "machine.hpp"
+
+// Machine with everything connected, as in the emulator
+static Machine *new_machine() {
+    Machine *m = new Machine();
+    m->connect_block_cache();
+    m->connect_peripherals();
+    return m;
+}
+
+// Tile data, both tile maps, 40 sprites and register values that turn
+// on the background, the window (from line 72, x 80) and 8x8 sprites
+static void fill_video(Machine &m) {
+    uint32_t state = 0x9E3779B9;
+    for (uint16_t addr = 0x8000; addr < 0x9800; addr++) {
+        state = state * 1664525u + 1013904223u;
+        m.bus.write_raw(addr, static_cast<uint8_t>(state >> 24));
+    }
+    for (uint16_t i = 0; i < 0x800; i++) {
+        m.bus.write_raw(0x9800 + i, static_cast<uint8_t>(i * 7));
+    }
+    for (uint8_t i = 0; i < 40; i++) {
+        uint16_t oam = 0xFE00 + i * 4;
+        m.bus.write_raw(oam, static_cast<uint8_t>(16 + (i * 37) % 144)); // y + 16
+        m.bus.write_raw(oam + 1, static_cast<uint8_t>(8 + (i * 53) % 160)); // x + 8
+        m.bus.write_raw(oam + 2, i);
+        m.bus.write_raw(oam + 3, static_cast<uint8_t>((i & 3) << 5)); // mix of flips
+    }
+    m.bus.write_raw(0xFF40, 0xE3); // LCD, window (map 0x9C00), sprites, background on
+    m.bus.write_raw(0xFF42, 0x13); // SCY
+    m.bus.write_raw(0xFF43, 0x05); // SCX
+    m.bus.write_raw(0xFF47, 0xE4); // BGP
+    m.bus.write_raw(0xFF48, 0xD2); // OBP0
+    m.bus.write_raw(0xFF49, 0x1B); // OBP1
+    m.bus.write_raw(0xFF4A, 72);   // WY
+    m.bus.write_raw(0xFF4B, 87);   // WX (x + 7)
+    m.ppu.updateRegs();
+}
+
+// Random addresses inside [lo, hi], fixed seed so runs are comparable
+static std::vector<uint16_t> make_addresses(uint16_t lo, uint16_t hi, size_t count) {
+    std::vector<uint16_t> addrs(count);
+    uint32_t state = 0x12345678;
+    for (size_t i = 0; i < count; i++) {
+        state = state * 1664525u + 1013904223u;
+        addrs[i] = lo + (state >> 8) % (hi - lo + 1);
+    }
+    return addrs;
+}
+
+// Keeps results alive so the compiler can't drop the measured loops
+static volatile uint32_t sink;
+
+struct Result {
+    const char *name;
+    const char *unit;
+    double rate; // units per second
+};
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static Result bench_reads(const char *name, uint16_t lo, uint16_t hi) {
+    Machine *m = new_machine();
+    std::vector<uint16_t> addrs = make_addresses(lo, hi, 4096);
+    const int rounds = 20000;
+
+    uint32_t sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (uint16_t addr : addrs) {
+            sum += m->bus.read_mem(addr);
+        }
+    }
+    double seconds = seconds_since(start);
+    sink = sum;
+    delete m;
+    return {name, "M reads/s", rounds * addrs.size() / seconds / 1e6};
+}
+
+static Result bench_writes(const char *name, uint16_t lo, uint16_t hi) {
+    Machine *m = new_machine();
+    std::vector<uint16_t> addrs = make_addresses(lo, hi, 4096);
+    const int rounds = 20000;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (uint16_t addr : addrs) {
+            m->bus.write_mem(addr, static_cast<uint8_t>(r));
+        }
+    }
+    double seconds = seconds_since(start);
+    sink = m->bus.read_mem(lo);
+    delete m;
+    return {name, "M writes/s", rounds * addrs.size() / seconds / 1e6};
+}
+
+static Result bench_stack() {
+    Machine *m = new_machine();
+    const int rounds = 20000000;
+
+    uint32_t sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        m->bus.push_stack(0xDFF0, static_cast<uint16_t>(r));
+        sum += m->bus.pop_stack(0xDFEE);
+    }
+    double seconds = seconds_since(start);
+    sink = sum;
+    delete m;
+    return {"stack push+pop (WRAM)", "M pairs/s", rounds / seconds / 1e6};
+}
+
+// The copy loop below, fetched and dispatched one instruction at a time
+// (CPU::fetch_instruction + the opcode tables, no block cache)
+static Result bench_cpu_step() {
+    Machine *m = new_machine();
+    m->cpu.connect_block_cache(nullptr);
+    m->load(0x0100, {0x21, 0x00, 0xC0, 0x11, 0x00, 0xD0, 0x2A, 0x12, 0x1C, 0x20, 0xFB, 0x18, 0xF3});
+    const int instructions = 50000000;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < instructions; i++) {
+        m->cpu.execute_instruction(m->cpu.fetch_instruction());
+    }
+    double seconds = seconds_since(start);
+    delete m;
+    return {"CPU fetch+dispatch (step)", "M instrs/s", instructions / seconds / 1e6};
+}
+
+// Byte copy loop from 0xC000 to 0xD000 running from ROM:
+//   0100 LD HL,C000 / LD DE,D000
+//   0106 LD A,(HL+) / LD (DE),A / INC E / JR NZ,0106
+//   010B JR 0100
+static Result bench_cpu_copy() {
+    Machine *m = new_machine();
+    m->load(0x0100, {0x21, 0x00, 0xC0, 0x11, 0x00, 0xD0, 0x2A, 0x12, 0x1C, 0x20, 0xFB, 0x18, 0xF3});
+    const uint64_t budget = 50000000;
+
+    auto start = std::chrono::steady_clock::now();
+    m->cpu.run(budget);
+    double seconds = seconds_since(start);
+    uint64_t cycles = m->cpu.get_cycles();
+    delete m;
+    return {"CPU copy loop (block cache)", "M M-cycles/s", cycles / seconds / 1e6};
+}
+
+// ALU loop, flags written by every instruction and read only by the branch:
+//   0100 LD C,11 / LD D,05 / LD E,3C
+//   0106 ADD A,C / SUB D / AND E / OR C / XOR D / CP E / INC A / DEC B / JR NZ,0106
+//   0110 JR 0106
+static Result bench_cpu_alu() {
+    Machine *m = new_machine();
+    m->load(0x0100, {0x0E, 0x11, 0x16, 0x05, 0x1E, 0x3C, 0x81, 0x92, 0xA3, 0xB1, 0xAA, 0xBB, 0x3C, 0x05,
+                     0x20, 0xF6, 0x18, 0xF4});
+    const uint64_t budget = 50000000;
+
+    auto start = std::chrono::steady_clock::now();
+    m->cpu.run(budget);
+    double seconds = seconds_since(start);
+    uint64_t cycles = m->cpu.get_cycles();
+    delete m;
+    return {"CPU ALU loop (block cache)", "M M-cycles/s", cycles / seconds / 1e6};
+}
+
+// Rotate/shift and DAA loop (the table-driven handlers):
+//   0100 LD C,11 / LD D,05 / LD E,3C
+//   0106 RLC C / RRC D / RL E / RR C / SLA D / SRA E / SWAP C / SRL D / DAA / DEC B / JR NZ,0106
+//   011A JR 0106
+static Result bench_cpu_shift() {
+    Machine *m = new_machine();
+    m->load(0x0100, {0x0E, 0x11, 0x16, 0x05, 0x1E, 0x3C, 0xCB, 0x01, 0xCB, 0x0A, 0xCB, 0x13, 0xCB, 0x19,
+                     0xCB, 0x22, 0xCB, 0x2B, 0xCB, 0x31, 0xCB, 0x3A, 0x27, 0x05, 0x20, 0xEC, 0x18, 0xEA});
+    const uint64_t budget = 50000000;
+
+    auto start = std::chrono::steady_clock::now();
+    m->cpu.run(budget);
+    double seconds = seconds_since(start);
+    uint64_t cycles = m->cpu.get_cycles();
+    delete m;
+    return {"CPU shift/DAA loop (block cache)", "M M-cycles/s", cycles / seconds / 1e6};
+}
+
+// PPU with its default register state, driven by its own events
+static Result bench_ppu_frames() {
+    Machine *m = new_machine();
+    const int frames = 200;
+
+    int rendered = 0;
+    Event event;
+    auto start = std::chrono::steady_clock::now();
+    while (rendered < frames && m->scheduler.pop_due(UINT64_MAX, event)) {
+        if (event.type == EVENT_PPU && m->ppu.handle_event(event.time)) {
+            rendered++;
+        }
+    }
+    double seconds = seconds_since(start);
+    delete m;
+    return {"PPU frame (mode events)", "frames/s", frames / seconds};
+}
+
+// One PPU scanline stage over all 144 visible lines of the synthetic
+// screen. The sprite stage needs each line's OAM scan first, which is
+// timed along with it.
+enum ScanlineStage { STAGE_BACKGROUND, STAGE_WINDOW, STAGE_SPRITES, STAGE_PIXELS };
+
+static Result bench_scanlines(const char *name, ScanlineStage stage) {
+    Machine *m = new_machine();
+    fill_video(*m);
+    const int frames = 2000;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; f++) {
+        for (uint8_t row = 0; row < 144; row++) {
+            switch (stage) {
+                case STAGE_BACKGROUND:
+                    m->ppu.updateBackground(row);
+                    break;
+                case STAGE_WINDOW:
+                    m->ppu.updateWindow(row);
+                    break;
+                case STAGE_SPRITES:
+                    m->ppu.scanOAM(row);
+                    m->ppu.updateSprites(row);
+                    break;
+                case STAGE_PIXELS:
+                    m->ppu.updatePixelData(row);
+                    break;
+            }
+        }
+    }
+    double seconds = seconds_since(start);
+    delete m;
+    return {name, "K lines/s", frames * 144 / seconds / 1e3};
+}
+
+// One frame's worth of pixel kernel work with one kernel version: every
+// tile decoded, then 144 lines through BGP and to ARGB
+static Result bench_pixel_kernels(const char *name, const PixelKernels &k) {
+    uint8_t tiles[TileCache::TILE_COUNT][16];
+    uint32_t state = 0x9E3779B9;
+    for (int tile = 0; tile < TileCache::TILE_COUNT; tile++) {
+        for (int i = 0; i < 16; i++) {
+            state = state * 1664525u + 1013904223u;
+            tiles[tile][i] = static_cast<uint8_t>(state >> 24);
+        }
+    }
+    static uint8_t pixels[TileCache::TILE_COUNT][8][8];
+    static uint8_t colors[144][160];
+    static uint32_t argb[144][160];
+    const int frames = 5000;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; f++) {
+        for (int tile = 0; tile < TileCache::TILE_COUNT; tile++) {
+            k.decode_tile(tiles[tile], pixels[tile]);
+        }
+        for (int row = 0; row < 144; row++) {
+            k.map_palette(pixels[(row + f) % TileCache::TILE_COUNT][0], 0xE4, colors[row], 160);
+            k.to_argb(colors[row], argb[row], 160);
+        }
+    }
+    double seconds = seconds_since(start);
+    sink = argb[143][159] + pixels[0][0][0];
+    return {name, "K frames/s", frames / seconds / 1e3};
+}
+
+// Writing 0xFF46 (source copied into the DMA buffer) followed by the
+// completion event (buffer copied to OAM)
+static Result bench_dma() {
+    Machine *m = new_machine();
+    fill_video(*m);
+    const int transfers = 2000000;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < transfers; i++) {
+        m->bus.write_mem(0xFF46, (i & 1) ? 0xC0 : 0x80);
+        m->bus.dma_transfer();
+    }
+    double seconds = seconds_since(start);
+    sink = m->bus.read_mem(0xFE00);
+    delete m;
+    return {"OAM DMA (0xFF46 write + transfer)", "M DMAs/s", transfers / seconds / 1e6};
+}
+
+// CPU::handle_interrupts with IME set and every interrupt enabled but none
+// requested: the check made before every run() slice
+static Result bench_interrupt_poll() {
+    Machine *m = new_machine();
+    m->bus.write_mem(0xFFFF, 0x1F);
+    m->bus.write_mem(0xFF0F, 0x00);
+    const int polls = 100000000;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < polls; i++) {
+        m->cpu.handle_interrupts();
+    }
+    double seconds = seconds_since(start);
+    sink = m->cpu.get_pc();
+    delete m;
+    return {"interrupt poll (none pending)", "M polls/s", polls / seconds / 1e6};
+}
+
+int main() {
+    const PixelKernels *kernels[3];
+    int kernel_count = available_pixel_kernels(kernels);
+    std::cout << "pixel kernels: " << pixel_kernels().name << "\n";
+
+    std::vector<Result> results;
+    results.push_back(bench_reads("read ROM/VRAM/WRAM", 0x0000, 0x9FFF));
+    results.push_back(bench_reads("read ROM", 0x0000, 0x7FFF));
+    results.push_back(bench_reads("read VRAM", 0x8000, 0x9FFF));
+    results.push_back(bench_reads("read external RAM", 0xA000, 0xBFFF));
+    results.push_back(bench_reads("read WRAM", 0xC000, 0xDFFF));
+    results.push_back(bench_reads("read echo RAM", 0xE000, 0xFDFF));
+    results.push_back(bench_reads("read OAM", 0xFE00, 0xFE9F));
+    results.push_back(bench_reads("read I/O", 0xFF00, 0xFF7F));
+    results.push_back(bench_reads("read HRAM", 0xFF80, 0xFFFE));
+    results.push_back(bench_writes("write VRAM", 0x8000, 0x9FFF));
+    results.push_back(bench_writes("write external RAM", 0xA000, 0xBFFF));
+    results.push_back(bench_writes("write WRAM", 0xC000, 0xDFFF));
+    results.push_back(bench_writes("write echo RAM", 0xE000, 0xFDFF));
+    results.push_back(bench_writes("write OAM", 0xFE00, 0xFE9F));
+    results.push_back(bench_writes("write I/O (SCY/SCX)", 0xFF42, 0xFF43));
+    results.push_back(bench_writes("write HRAM", 0xFF80, 0xFFFE));
+    results.push_back(bench_stack());
+    results.push_back(bench_cpu_step());
+    results.push_back(bench_cpu_copy());
+    results.push_back(bench_cpu_alu());
+    results.push_back(bench_cpu_shift());
+    results.push_back(bench_scanlines("PPU updateBackground", STAGE_BACKGROUND));
+    results.push_back(bench_scanlines("PPU updateWindow", STAGE_WINDOW));
+    results.push_back(bench_scanlines("PPU scanOAM+updateSprites", STAGE_SPRITES));
+    results.push_back(bench_scanlines("PPU updatePixelData", STAGE_PIXELS));
+    std::string kernel_labels[3];
+    for (int i = 0; i < kernel_count; i++) {
+        kernel_labels[i] = std::string("pixel kernels (") + kernels[i]->name + ")";
+        results.push_back(bench_pixel_kernels(kernel_labels[i].c_str(), *kernels[i]));
+    }
+    results.push_back(bench_ppu_frames());
+    results.push_back(bench_dma());
+    results.push_back(bench_interrupt_poll());
+
+    for (const Result &r : results) {
+        std::cout << std::left << std::setw(36) << r.name << std::right << std::setw(12) << std::fixed
+                  << std::setprecision(1) << r.rate << " " << r.unit << "\n";
+    }
+    return 0;
+}
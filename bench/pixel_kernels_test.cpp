@@ -0,0 +1,26 @@
+/**
+ * pixel_kernels_test - check every pixel kernel version this build has and
+ * the host CPU can run against the scalar kernels, over every tile row,
+ * palette and color byte (see pixel_kernels_verify). Exits non-zero on the
+ * first difference.
+ *
+ * Usage: pixel_kernels_test
+ */
+
+#include <iostream>
+
+#include "../include/pixel_kernels.hpp"
+
+int main() {
+    const PixelKernels *kernels[3];
+    int count = available_pixel_kernels(kernels);
+    for (int i = 0; i < count; i++) {
+        if (!pixel_kernels_verify(*kernels[i])) {
+            std::cout << "pixel kernels: " << kernels[i]->name << " FAILED\n";
+            return 1;
+        }
+        std::cout << "pixel kernels: " << kernels[i]->name << " OK\n";
+    }
+    std::cout << "selected: " << pixel_kernels().name << "\n";
+    return 0;
+}
@@ -0,0 +1,215 @@
+/**
+ * ppu_test - check the PPU's per-line rendering against straightforward
+ * reference versions that read VRAM and OAM through the bus:
+ *
+ *   window   updateWindow's windowLine, for every line of a frame over a
+ *            grid of LCDC, WX, WY and BGP values, against a per-pixel
+ *            window fetch with its own window line counter
+ *   sprites  scanOAM's per-line sprite list, built from the sprite
+ *            buckets, against a scan of all 40 OAM entries sorted by
+ *            priority, while OAM changes through the bus, the PPU, the
+ *            stack and OAM DMA between frames
+ *
+ * Exits non-zero if any line differs.
+ *
+ * Usage: ppu_test
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "machine.hpp"
+
+static const int WIDTH = 160;
+static const int HEIGHT = 144;
+
+// Lines printed in full before only counting the rest
+static const int MAX_REPORTS = 5;
+
+static uint32_t random_state = 0x12345678;
+
+static uint8_t random_byte() {
+    random_state = random_state * 1664525u + 1013904223u;
+    return static_cast<uint8_t>(random_state >> 24);
+}
+
+// Pixel x of window row window_y, as a COLOR: tile map per LCDC bit 6,
+// tile data addressing per LCDC bit 4
+static uint8_t reference_window_pixel(Bus &bus, uint8_t lcdc, uint8_t bgp, int window_y, int x) {
+    uint16_t map = (lcdc & 0x40) ? 0x9C00 : 0x9800;
+    uint8_t tile = bus.read_raw(map + (window_y / 8) * 32 + x / 8);
+    int addr = (lcdc & 0x10) ? 0x8000 + tile * 16 : 0x9000 + static_cast<int8_t>(tile) * 16;
+    addr += (window_y % 8) * 2;
+    int bit = 7 - x % 8;
+    int index = ((bus.read_raw(addr) >> bit) & 1) | (((bus.read_raw(addr + 1) >> bit) & 1) << 1);
+    return (bgp >> (2 * index)) & 0b11;
+}
+
+static bool check_window() {
+    Machine *m = new Machine();
+    for (int addr = 0x8000; addr < 0xA000; addr++) {
+        m->bus.write_mem(addr, random_byte());
+    }
+
+    const uint8_t lcdcs[] = {0xE3, 0xA3, 0xF3, 0xB3, 0xC3, 0x83}; // window on/off, both maps, both data areas
+    const uint8_t wxs[] = {0, 3, 7, 8, 50, 87, 166, 167, 200};
+    const uint8_t wys[] = {0, 1, 72, 143, 144};
+    const uint8_t bgps[] = {0xE4, 0x1B};
+
+    int lines = 0;
+    int bad = 0;
+    for (uint8_t lcdc : lcdcs) {
+        for (uint8_t wx : wxs) {
+            for (uint8_t wy : wys) {
+                for (uint8_t bgp : bgps) {
+                    m->bus.write_raw(0xFF40, lcdc);
+                    m->bus.write_raw(0xFF4A, wy);
+                    m->bus.write_raw(0xFF4B, wx);
+                    m->bus.write_raw(0xFF47, bgp);
+                    m->ppu.updateRegs();
+
+                    int window_y = 0; // only advances on lines that show the window
+                    for (int row = 0; row < HEIGHT; row++) {
+                        m->ppu.updateWindow(row);
+
+                        uint8_t expected[WIDTH];
+                        bool shown = (lcdc & 0x20) && row >= wy && wx - 7 < WIDTH;
+                        for (int x = 0; x < WIDTH; x++) {
+                            int window_x = x - (wx - 7);
+                            expected[x] = (shown && window_x >= 0)
+                                              ? reference_window_pixel(m->bus, lcdc, bgp, window_y, window_x)
+                                              : static_cast<uint8_t>(WINDOW_TRANSPARENT);
+                        }
+                        if (shown) {
+                            window_y++;
+                        }
+
+                        const uint8_t *line = m->ppu.window_line();
+                        lines++;
+                        for (int x = 0; x < WIDTH; x++) {
+                            if (line[x] != expected[x]) {
+                                if (bad < MAX_REPORTS) {
+                                    std::cout << std::hex << "window: LCDC " << +lcdc << std::dec << " WX " << +wx
+                                              << " WY " << +wy << " line " << row << " x " << x << ": "
+                                              << +line[x] << ", expected " << +expected[x] << "\n";
+                                }
+                                bad++;
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    delete m;
+    std::cout << "window: " << lines << " lines, " << bad << " differ\n";
+    return bad == 0;
+}
+
+// The first 10 OAM entries (in OAM order) on line row, sorted by
+// drawing priority. X = 0 hides a sprite.
+static std::vector<Sprite> reference_sprites(Bus &bus, int row, bool tall) {
+    int height = tall ? 16 : 8;
+    std::vector<Sprite> sprites;
+    for (int i = 0; i < 40 && sprites.size() < 10; i++) {
+        uint16_t entry = Bus::OAM_START + i * 4;
+        int y = bus.read_raw(entry) - 16;
+        uint8_t x = bus.read_raw(entry + 1);
+        if (row >= y && row < y + height && x > 0) {
+            sprites.emplace_back(bus.read_raw(entry), x, bus.read_raw(entry + 2), bus.read_raw(entry + 3), i);
+        }
+    }
+    std::sort(sprites.begin(), sprites.end());
+    return sprites;
+}
+
+static bool same_sprite(const Sprite &a, const Sprite &b) {
+    return a.y == b.y && a.x == b.x && a.tileIndex == b.tileIndex && a.flags == b.flags &&
+           a.oam_index == b.oam_index;
+}
+
+// A random byte for an OAM address: mostly on-screen Y and crowded X, so
+// lines overflow 10
+static uint8_t random_oam_byte(uint16_t addr) {
+    uint8_t data = random_byte();
+    if ((addr & 3) == 0) {
+        data %= 180;
+    } else if ((addr & 3) == 1) {
+        data = (data & 3) ? data % 40 : 0;
+    }
+    return data;
+}
+
+static bool check_sprites() {
+    Machine *m = new Machine();
+    const int frames = 3000;
+
+    int lines = 0;
+    int bad = 0;
+    for (int frame = 0; frame < frames; frame++) {
+        // One kind of OAM change per frame, so each has to invalidate the
+        // buckets by itself: writes through the bus, writes through the
+        // PPU, pushes with SP in OAM, an OAM DMA, or nothing
+        int change = random_byte() % 12;
+        if (change < 8) {
+            int writes = 1 + random_byte() % 20;
+            for (int i = 0; i < writes; i++) {
+                uint16_t addr = Bus::OAM_START + random_byte() % Bus::OAM_SIZE;
+                uint8_t data = random_oam_byte(addr);
+                if (change < 4) {
+                    m->bus.write_mem(addr, data);
+                } else {
+                    m->ppu.write_mem(addr, data);
+                }
+            }
+        } else if (change < 10) {
+            int pushes = 1 + random_byte() % 10;
+            for (int i = 0; i < pushes; i++) {
+                uint16_t sp = Bus::OAM_START + 2 + random_byte() % (Bus::OAM_SIZE - 1);
+                uint8_t msb = random_oam_byte(sp - 1);
+                uint8_t lsb = random_oam_byte(sp - 2);
+                m->bus.push_stack(sp, (msb << 8) | lsb);
+            }
+        } else if (change == 10) {
+            for (int i = 0; i < Bus::OAM_SIZE; i++) {
+                m->bus.dma_buffer[i] = random_byte() % 170;
+            }
+            m->bus.dma_transfer();
+        }
+        bool tall = random_byte() & 1;
+        m->bus.write_raw(0xFF40, tall ? 0x87 : 0x83);
+        m->ppu.updateRegs();
+
+        for (int row = 0; row < HEIGHT; row++) {
+            std::vector<Sprite> expected = reference_sprites(m->bus, row, tall);
+            m->ppu.scanOAM(row);
+            int count;
+            const Sprite *sprites = m->ppu.line_sprites(count);
+            lines++;
+
+            bool same = count == static_cast<int>(expected.size());
+            for (int i = 0; same && i < count; i++) {
+                same = same_sprite(sprites[i], expected[i]);
+            }
+            if (!same) {
+                if (bad < MAX_REPORTS) {
+                    std::cout << "sprites: frame " << frame << " line " << row << ": " << count
+                              << " sprites, expected " << expected.size() << "\n";
+                }
+                bad++;
+            }
+        }
+    }
+    std::cout << "sprites: " << lines << " lines, " << bad << " differ, " << m->ppu.sprite_bucket_rebuilds()
+              << " bucket rebuilds over " << frames << " frames\n";
+    delete m;
+    return bad == 0;
+}
+
+int main() {
+    bool ok = check_window();
+    ok = check_sprites() && ok;
+    return ok ? 0 : 1;
+}
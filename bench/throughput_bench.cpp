@@ -0,0 +1,305 @@
+/**
+ * throughput_bench - run every ROM in games/ and tests/ headlessly for a
+ * fixed number of frames and measure how fast the whole machine goes:
+ * emulated M-cycles per second, frames per second, speed as a multiple of
+ * the real hardware, and peak RSS.
+ *
+ * Each ROM runs in its own forked process, so peak RSS is per ROM and a
+ * crash only loses that ROM. Each ROM is run several times and the fastest
+ * run is kept, to take out some host noise. Results are written as JSON
+ * (one ROM object per line). Given a baseline file written by an earlier run, the speed of
+ * each ROM is compared against it; any ROM slower than the baseline by more
+ * than the tolerance makes the exit status non-zero.
+ *
+ * Usage: throughput_bench [--frames N] [--repeat N] [--out results.json]
+ *                         [--baseline baseline.json] [--tolerance percent] [rom ...]
+ */
+
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../include/emulator.hpp"
+
+// M-cycles per second of the real hardware
+static const double CYCLES_PER_SECOND = 1048576.0;
+
+// What the child process sends back through its pipe
+struct ChildResult {
+    uint64_t frames;
+    uint64_t cycles;
+    uint64_t idle_cycles;
+    double seconds;
+    bool ok;
+};
+
+struct RomResult {
+    std::string rom;
+    ChildResult run;
+    long peak_rss_kb;
+    bool finished; // the child exited normally and reported back
+};
+
+// Child side: run the ROM and write a ChildResult to fd
+static void run_child(const std::string &rom, uint64_t max_frames, int fd) {
+    // Keep the ROM loading messages out of the report
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd >= 0) {
+        dup2(null_fd, STDOUT_FILENO);
+        close(null_fd);
+    }
+
+    ChildResult result = {0, 0, 0, 0.0, false};
+    Emulator *emu = new Emulator();
+    if (emu->load_rom(rom)) {
+        result.ok = true;
+        auto start = std::chrono::steady_clock::now();
+        while (true) {
+            emu->service_events();
+            if (emu->frames >= max_frames) {
+                break;
+            }
+            if (!emu->run_cpu()) {
+                std::cerr << rom << ": unknown instruction " << std::hex << emu->cpu.fetch_instruction()
+                          << std::dec << " at M-cycle " << emu->cpu.get_cycles() << "\n";
+                result.ok = false;
+                break;
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+        result.seconds = std::chrono::duration<double>(end - start).count();
+        result.frames = emu->frames;
+        result.cycles = emu->cpu.get_cycles();
+        result.idle_cycles = emu->cpu.idle_cycles_skipped;
+    }
+    if (write(fd, &result, sizeof(result)) != sizeof(result)) {
+        _exit(2);
+    }
+    _exit(0);
+}
+
+static RomResult run_rom(const std::string &rom, uint64_t max_frames) {
+    RomResult result = {rom, {0, 0, 0, 0.0, false}, 0, false};
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return result;
+    }
+
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        run_child(rom, max_frames, fds[1]);
+    }
+    close(fds[1]);
+    if (pid < 0) {
+        close(fds[0]);
+        return result;
+    }
+
+    ssize_t got = read(fds[0], &result.run, sizeof(result.run));
+    close(fds[0]);
+
+    int status = 0;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) == pid) {
+#ifdef __APPLE__
+        result.peak_rss_kb = usage.ru_maxrss / 1024; // bytes on macOS
+#else
+        result.peak_rss_kb = usage.ru_maxrss;        // kilobytes on Linux
+#endif
+        result.finished = WIFEXITED(status) && WEXITSTATUS(status) == 0 &&
+                          got == static_cast<ssize_t>(sizeof(result.run));
+    }
+    if (!result.finished) {
+        result.run.ok = false;
+    }
+    return result;
+}
+
+static double cycles_per_sec(const RomResult &r) {
+    return r.run.seconds > 0 ? r.run.cycles / r.run.seconds : 0.0;
+}
+
+static double frames_per_sec(const RomResult &r) {
+    return r.run.seconds > 0 ? r.run.frames / r.run.seconds : 0.0;
+}
+
+static std::string json_escape(const std::string &s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out;
+}
+
+static bool write_json(const std::string &path, uint64_t max_frames, const std::vector<RomResult> &results) {
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        std::cerr << "Error: Failed to open " << path << " for writing\n";
+        return false;
+    }
+    out << std::setprecision(10);
+    out << "{\n  \"frames\": " << max_frames << ",\n  \"roms\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const RomResult &r = results[i];
+        out << "    {\"rom\": \"" << json_escape(r.rom) << "\", \"ok\": " << (r.run.ok ? "true" : "false")
+            << ", \"frames\": " << r.run.frames << ", \"cycles\": " << r.run.cycles
+            << ", \"seconds\": " << r.run.seconds << ", \"cycles_per_sec\": " << cycles_per_sec(r)
+            << ", \"frames_per_sec\": " << frames_per_sec(r)
+            << ", \"speed\": " << cycles_per_sec(r) / CYCLES_PER_SECOND
+            << ", \"idle_cycles_skipped\": " << r.run.idle_cycles
+            << ", \"peak_rss_kb\": " << r.peak_rss_kb << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return true;
+}
+
+// Value of "key": <number> on a line of our own JSON output
+static bool json_number(const std::string &line, const std::string &key, double &value) {
+    size_t pos = line.find("\"" + key + "\": ");
+    if (pos == std::string::npos) {
+        return false;
+    }
+    std::istringstream in(line.substr(pos + key.size() + 4));
+    return static_cast<bool>(in >> value);
+}
+
+// ROM -> cycles_per_sec from a file written by write_json
+static bool read_baseline(const std::string &path, std::map<std::string, double> &baseline) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        std::cerr << "Error: Failed to open baseline " << path << "\n";
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t pos = line.find("\"rom\": \"");
+        double rate;
+        if (pos == std::string::npos || !json_number(line, "cycles_per_sec", rate)) {
+            continue;
+        }
+        size_t start = pos + 8;
+        std::string rom;
+        for (size_t i = start; i < line.size() && line[i] != '"'; i++) {
+            if (line[i] == '\\' && i + 1 < line.size()) {
+                i++;
+            }
+            rom += line[i];
+        }
+        baseline[rom] = rate;
+    }
+    return true;
+}
+
+static void add_roms(const std::string &dir, std::vector<std::string> &roms) {
+    std::error_code error;
+    std::vector<std::string> found;
+    for (const auto &entry : std::filesystem::directory_iterator(dir, error)) {
+        if (entry.path().extension() == ".gb") {
+            found.push_back(entry.path().string());
+        }
+    }
+    std::sort(found.begin(), found.end());
+    roms.insert(roms.end(), found.begin(), found.end());
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t max_frames = 600; // ten emulated seconds
+    std::string out_path = "bench_results.json";
+    std::string baseline_path;
+    unsigned repeat = 3;
+    double tolerance = 10.0; // percent
+    std::vector<std::string> roms;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--frames" && has_value) {
+            max_frames = std::stoull(argv[++i]);
+        } else if (arg == "--repeat" && has_value) {
+            repeat = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--out" && has_value) {
+            out_path = argv[++i];
+        } else if (arg == "--baseline" && has_value) {
+            baseline_path = argv[++i];
+        } else if (arg == "--tolerance" && has_value) {
+            tolerance = std::stod(argv[++i]);
+        } else if (arg[0] != '-') {
+            roms.push_back(arg);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--frames N] [--repeat N] [--out results.json] "
+                      << "[--baseline baseline.json] [--tolerance percent] [rom ...]\n";
+            return 1;
+        }
+    }
+    if (roms.empty()) {
+        add_roms("games", roms);
+        add_roms("tests", roms);
+    }
+
+    std::map<std::string, double> baseline;
+    if (!baseline_path.empty() && !read_baseline(baseline_path, baseline)) {
+        return 1;
+    }
+
+    std::cout << "Frames per ROM: " << max_frames << ", best of " << repeat << " runs\n\n"
+              << std::left << std::setw(28) << "ROM" << std::right << std::setw(13) << "M-cycles/s"
+              << std::setw(10) << "frames/s" << std::setw(9) << "speed" << std::setw(11) << "peak RSS"
+              << (baseline.empty() ? "" : "  vs baseline") << "\n";
+
+    int status = 0;
+    std::vector<RomResult> results;
+    for (const std::string &rom : roms) {
+        RomResult r = run_rom(rom, max_frames);
+        for (unsigned i = 1; i < repeat && r.run.ok; i++) {
+            RomResult again = run_rom(rom, max_frames);
+            if (!again.run.ok || again.run.seconds < r.run.seconds) {
+                r = again;
+            }
+        }
+        results.push_back(r);
+
+        std::cout << std::left << std::setw(28) << rom << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(12) << cycles_per_sec(r) / 1e6 << "M" << std::setw(9) << std::setprecision(0)
+                  << frames_per_sec(r) << std::setw(8) << std::setprecision(1)
+                  << cycles_per_sec(r) / CYCLES_PER_SECOND << "x" << std::setw(8) << r.peak_rss_kb / 1024.0
+                  << " MB";
+        if (!r.run.ok) {
+            std::cout << "  FAILED";
+            status = 1;
+        }
+        auto base = baseline.find(rom);
+        if (r.run.ok && base != baseline.end() && base->second > 0) {
+            double change = 100.0 * (cycles_per_sec(r) / base->second - 1.0);
+            std::cout << "  " << std::showpos << change << "%" << std::noshowpos;
+            if (change < -tolerance) {
+                std::cout << " REGRESSION";
+                status = 1;
+            }
+        }
+        std::cout << std::defaultfloat << std::setprecision(6) << "\n";
+    }
+
+    if (!write_json(out_path, max_frames, results)) {
+        return 1;
+    }
+    std::cout << "\nResults written to " << out_path << "\n";
+    return status;
+}
@@ -0,0 +1,98 @@
+/**
+ * trace_decode - print a binary execution trace written by an ENABLE_TRACE
+ * build (gheithboy-headless --trace, or trace.bin from the SDL frontend),
+ * one instruction per line:
+ *
+ *   cycles PC: bytes  name  A:.. F:.. B:.. C:.. D:.. E:.. H:.. L:.. SP:....  [IME] [HALT]  writes
+ *
+ * Registers are the state before the instruction; writes are the bus
+ * writes it made, as [addr]=data. The file is read in chunks, so traces
+ * larger than memory are fine.
+ *
+ * Usage: trace_decode <trace.bin> [first [count]]
+ *   first  index of the first record to print (default 0)
+ *   count  number of records to print (default: all)
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../include/cpu.hpp"
+#include "../include/trace.hpp"
+
+// Records read per fread
+static const size_t CHUNK_RECORDS = 4096;
+
+static void print_record(CPU &cpu, const TraceRecord &r) {
+    uint32_t instruction = (static_cast<uint32_t>(r.bytes[0]) << 16) | (static_cast<uint32_t>(r.bytes[1]) << 8) |
+                           r.bytes[2];
+    uint8_t length = CPU::get_instruction_length(r.bytes[0]);
+
+    char bytes[12] = "";
+    for (uint8_t i = 0; i < length && i < 3; i++) {
+        snprintf(bytes + strlen(bytes), sizeof(bytes) - strlen(bytes), "%02X ", r.bytes[i]);
+    }
+    printf("%12llu %04X: %-9s %-12s A:%02X F:%02X B:%02X C:%02X D:%02X E:%02X H:%02X L:%02X SP:%04X",
+           static_cast<unsigned long long>(r.cycles), r.pc, bytes, cpu.get_instruction_name(instruction),
+           r.af >> 8, r.af & 0xFF, r.bc >> 8, r.bc & 0xFF, r.de >> 8, r.de & 0xFF, r.hl >> 8, r.hl & 0xFF, r.sp);
+    printf("%s%s", (r.state & TRACE_IME) ? " IME" : "", (r.state & TRACE_HALTED) ? " HALT" : "");
+    for (uint8_t i = 0; i < r.write_count && i < 2; i++) {
+        printf(" [%04X]=%02X", r.write_addr[i], r.write_data[i]);
+    }
+    if (r.write_count > 2) {
+        printf(" (+%u more)", r.write_count - 2);
+    }
+    printf("\n");
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 4) {
+        std::cerr << "Usage: " << argv[0] << " <trace.bin> [first [count]]\n";
+        return 1;
+    }
+    uint64_t first = argc > 2 ? std::stoull(argv[2]) : 0;
+    uint64_t count = argc > 3 ? std::stoull(argv[3]) : UINT64_MAX;
+
+    FILE *file = fopen(argv[1], "rb");
+    if (!file) {
+        std::cerr << "Error: Failed to open trace file " << argv[1] << std::endl;
+        return 1;
+    }
+    TraceHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0) {
+        std::cerr << "Error: " << argv[1] << " is not a trace file" << std::endl;
+        fclose(file);
+        return 1;
+    }
+    if (header.version != TRACE_VERSION || header.record_size != sizeof(TraceRecord)) {
+        std::cerr << "Error: " << argv[1] << " is trace version " << header.version << " with "
+                  << header.record_size << "-byte records; this decoder reads version " << TRACE_VERSION
+                  << " with " << sizeof(TraceRecord) << "-byte records" << std::endl;
+        fclose(file);
+        return 1;
+    }
+    if (first > 0 && fseeko(file, static_cast<off_t>(first * sizeof(TraceRecord)), SEEK_CUR) != 0) {
+        std::cerr << "Error: Failed to seek to record " << first << std::endl;
+        fclose(file);
+        return 1;
+    }
+
+    CPU *cpu = new CPU(); // only for the instruction names
+    std::vector<TraceRecord> chunk(CHUNK_RECORDS);
+    uint64_t printed = 0;
+    while (printed < count) {
+        size_t got = fread(chunk.data(), sizeof(TraceRecord), chunk.size(), file);
+        if (got == 0) {
+            break;
+        }
+        for (size_t i = 0; i < got && printed < count; i++, printed++) {
+            print_record(*cpu, chunk[i]);
+        }
+    }
+    fclose(file);
+    delete cpu;
+    return 0;
+}
@@ -0,0 +1,230 @@
+/**
+ * trace_diff - run a ROM one instruction at a time and compare the CPU
+ * state before every instruction against a reference log in the common
+ * Game Boy Doctor format, one line per instruction:
+ *
+ *   A:01 F:B0 B:00 C:13 D:00 E:D8 H:01 L:4D SP:FFFE PC:0100 PCMEM:00,C3,13,02
+ *
+ * Stops at the first line that differs and prints the instructions leading
+ * up to it. Only the fields present in the reference line are compared
+ * (logs without PCMEM work too). The reference is read a line at a time,
+ * so logs of any size are fine. Nothing is logged while the CPU is halted.
+ *
+ * Like those logs, LY (0xFF44) reads as 0x90 unless --real-ly is given, so
+ * that loops waiting for VBlank behave the same in every emulator.
+ *
+ * Usage: trace_diff [options] <rom> <reference.log>
+ *        trace_diff [options] --write <out.log> --max N <rom>
+ *   --write FILE  write this emulator's log instead of comparing (to record
+ *                 a reference from a known-good build)
+ *   --max N       stop after N instructions (default: end of the reference)
+ *   --context N   instructions to show before a divergence (default 10)
+ *   --real-ly     don't force LY to 0x90
+ */
+
+#include <stdio.h>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "../include/emulator.hpp"
+
+static const uint16_t LY_ADDR = 0xFF44;
+static const uint8_t LY_STUB = 0x90;
+
+static void usage(const char *name) {
+    std::cerr << "Usage: " << name << " [--max N] [--context N] [--real-ly] <rom> <reference.log>\n"
+              << "       " << name << " [--real-ly] --write <out.log> --max N <rom>\n";
+}
+
+// The CPU state before the next instruction, in reference log format
+static std::string state_line(Emulator &emu) {
+    CPU &cpu = emu.cpu;
+    uint16_t af = cpu.get_af(), bc = cpu.get_bc(), de = cpu.get_de(), hl = cpu.get_hl();
+    uint16_t pc = cpu.get_pc();
+    char line[96];
+    snprintf(line, sizeof(line),
+             "A:%02X F:%02X B:%02X C:%02X D:%02X E:%02X H:%02X L:%02X SP:%04X PC:%04X PCMEM:%02X,%02X,%02X,%02X",
+             af >> 8, af & 0xFF, bc >> 8, bc & 0xFF, de >> 8, de & 0xFF, hl >> 8, hl & 0xFF, cpu.get_sp(), pc,
+             emu.bus.read_mem(pc), emu.bus.read_mem(pc + 1), emu.bus.read_mem(pc + 2), emu.bus.read_mem(pc + 3));
+    return line;
+}
+
+// Value of field key ("A", "SP", ...) in a log line, or "" if it has none
+static std::string field(const std::string &line, const std::string &key) {
+    size_t pos = 0;
+    while (pos < line.size()) {
+        size_t end = line.find_first_of(" \t\r", pos);
+        if (end == std::string::npos) {
+            end = line.size();
+        }
+        size_t colon = line.find(':', pos);
+        if (colon < end && line.compare(pos, colon - pos, key) == 0 && colon - pos == key.size()) {
+            return line.substr(colon + 1, end - colon - 1);
+        }
+        pos = end + 1;
+    }
+    return "";
+}
+
+static bool same_hex(const std::string &a, const std::string &b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (toupper(static_cast<unsigned char>(a[i])) != toupper(static_cast<unsigned char>(b[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Compare the fields of a reference line against ours. Returns the ones
+// that differ, as "KEY (expected x, got y)", or "" if they all match.
+static std::string differences(const std::string &expected, const std::string &got) {
+    static const char *const keys[] = {"A", "F", "B", "C", "D", "E", "H", "L", "SP", "PC", "PCMEM"};
+    std::string diff;
+    bool any_field = false;
+    for (const char *key : keys) {
+        std::string want = field(expected, key);
+        if (want.empty()) {
+            continue;
+        }
+        any_field = true;
+        std::string have = field(got, key);
+        if (!same_hex(want, have)) {
+            diff += std::string(diff.empty() ? "" : ", ") + key + " (expected " + want + ", got " + have + ")";
+        }
+    }
+    return any_field ? diff : "unrecognized reference line";
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t max_instructions = 0; // 0: until the reference ends
+    size_t context = 10;
+    bool stub_ly = true;
+    std::string write_path;
+    std::string rom_name;
+    std::string reference_path;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--max" || arg == "--context" || arg == "--write") && i + 1 < argc) {
+            std::string value = argv[++i];
+            if (arg == "--max") {
+                max_instructions = std::stoull(value);
+            } else if (arg == "--context") {
+                context = std::stoul(value);
+            } else {
+                write_path = value;
+            }
+        } else if (arg == "--real-ly") {
+            stub_ly = false;
+        } else if (arg[0] != '-' && rom_name.empty()) {
+            rom_name = arg;
+        } else if (arg[0] != '-' && reference_path.empty()) {
+            reference_path = arg;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    bool writing = !write_path.empty();
+    if (rom_name.empty() || (writing ? (!reference_path.empty() || max_instructions == 0) : reference_path.empty())) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::ifstream reference;
+    std::ofstream out;
+    if (writing) {
+        out.open(write_path);
+        if (!out.is_open()) {
+            std::cerr << "Error: Failed to open " << write_path << " for writing" << std::endl;
+            return 1;
+        }
+    } else {
+        reference.open(reference_path);
+        if (!reference.is_open()) {
+            std::cerr << "Error: Failed to open reference log " << reference_path << std::endl;
+            return 1;
+        }
+    }
+
+    std::string rom_path = Emulator::find_rom(rom_name);
+    Emulator *emu = new Emulator();
+    if (!emu->load_rom(rom_path)) {
+        delete emu;
+        return 1;
+    }
+
+    // The last few matching instructions, for the report
+    std::deque<std::string> recent;
+    std::string expected;
+    uint64_t count = 0;
+    int status = 0;
+    while (max_instructions == 0 || count < max_instructions) {
+        emu->service_events();
+        emu->cpu.handle_interrupts();
+        if (stub_ly) {
+            emu->bus.write_raw(LY_ADDR, LY_STUB);
+        }
+
+        if (!emu->cpu.is_halted()) {
+            std::string got = state_line(*emu);
+            if (writing) {
+                out << got << '\n';
+            } else {
+                if (!std::getline(reference, expected)) {
+                    break; // the whole reference matched
+                }
+                if (!expected.empty() && expected.back() == '\r') {
+                    expected.pop_back();
+                }
+                if (expected != got) {
+                    std::string diff = differences(expected, got);
+                    if (!diff.empty()) {
+                        std::cout << "Divergence at line " << count + 1 << " (M-cycle " << emu->cpu.get_cycles()
+                                  << "):\n";
+                        for (const std::string &line : recent) {
+                            std::cout << "    " << line << "\n";
+                        }
+                        std::cout << "  expected: " << expected << "\n"
+                                  << "  got:      " << got << "\n"
+                                  << "  differs:  " << diff << "\n";
+                        status = 1;
+                        break;
+                    }
+                }
+                if (context > 0) {
+                    char number[24];
+                    snprintf(number, sizeof(number), "%10llu  ", static_cast<unsigned long long>(count + 1));
+                    recent.push_back(number + got + "  " + emu->cpu.get_instruction_name(emu->cpu.fetch_instruction()));
+                    if (recent.size() > context) {
+                        recent.pop_front();
+                    }
+                }
+            }
+            count++;
+        }
+
+        // Exactly one instruction (or one M-cycle of HALT)
+        if (!emu->cpu.run(emu->cpu.get_cycles() + 1)) {
+            std::cout << "Unimplemented opcode " << std::hex << emu->cpu.fetch_instruction() << " at PC "
+                      << emu->cpu.get_pc() << std::dec << " after " << count << " instructions\n";
+            status = 1;
+            break;
+        }
+    }
+
+    if (status == 0) {
+        if (writing) {
+            std::cout << "Wrote " << count << " instructions to " << write_path << "\n";
+        } else {
+            std::cout << "Matched " << count << " instructions of " << reference_path << "\n";
+        }
+    }
+    delete emu;
+    return status;
+}
@@ -1,30 +1,56 @@
 #pragma once
 #include <stdint.h>
 
-class MMU;
+// IF / IE bits, in priority order (the lowest set bit is serviced first)
+const uint8_t VBLANK_FLAG = 0x01;
+const uint8_t STAT_FLAG = 0x02;
+const uint8_t TIMER_FLAG = 0x04;
+const uint8_t SERIAL_FLAG = 0x08;
+const uint8_t JOYPAD_FLAG = 0x10;
+const uint8_t INTERRUPT_MASK = 0x1F;
+
+/**
+ * Owns the interrupt registers, IE (0xFFFF) and IF (0xFF0F). The bus
+ * forwards CPU accesses to them here, and the PPU and timer request
+ * interrupts by setting IF bits directly. IE & IF is kept up to date as
+ * the pending mask, so the CPU's check before every slice is one load.
+ */
 class InterruptHandler {
 private:
-	MMU* mmu;
-	bool interrupts_enabled;
+	uint8_t IE;
+	uint8_t IF; // only the five interrupt bits
+	uint8_t pending; // IE & IF & INTERRUPT_MASK
+	void update_pending() { pending = IE & IF & INTERRUPT_MASK; }
 public:
 	InterruptHandler();
-	~InterruptHandler();
-	void connect_mmu(MMU* mmu);
-	void enable_VBLANK_interrupt();
-	void disable_VBLANK_interrupt();
-	bool is_VBLANK_interrupt();
-	void enable_STAT_interrupt();
-	void disable_STAT_interrupt();
-	bool is_STAT_interrupt();
-	void enable_TIMER_interrupt();
-	void disable_TIMER_interrupt();
-	bool is_TIMER_interrupt();
-	void enable_SERIAL_interrupt();
-	void disable_SERIAL_interrupt();
-	bool is_SERIAL_interrupt();
-	void enable_JOYPAD_interrupt();
-	void disable_JOYPAD_interrupt();
-	bool is_JOYPAD_interrupt();
-	uint8_t get_IE();
-	uint8_t get_IF();
-};
\ No newline at end of file
+	~InterruptHandler() {}
+
+	// Requested and enabled interrupts (IME aside)
+	uint8_t get_pending() const { return pending; }
+
+	// Register access for the bus
+	uint8_t get_IE() const { return IE; }
+	uint8_t get_IF() const { return IF | 0xE0; } // top 3 bits always read as 1
+	void set_IE(uint8_t value) { IE = value; update_pending(); }
+	void set_IF(uint8_t value) { IF = value & INTERRUPT_MASK; update_pending(); }
+
+	// Set / clear IF bits (one of the *_FLAG constants)
+	void request(uint8_t flag) { IF |= flag; update_pending(); }
+	void acknowledge(uint8_t flag) { IF &= ~flag; update_pending(); }
+
+	void enable_VBLANK_interrupt() { request(VBLANK_FLAG); }
+	void disable_VBLANK_interrupt() { acknowledge(VBLANK_FLAG); }
+	bool is_VBLANK_interrupt() const { return IF & VBLANK_FLAG; }
+	void enable_STAT_interrupt() { request(STAT_FLAG); }
+	void disable_STAT_interrupt() { acknowledge(STAT_FLAG); }
+	bool is_STAT_interrupt() const { return IF & STAT_FLAG; }
+	void enable_TIMER_interrupt() { request(TIMER_FLAG); }
+	void disable_TIMER_interrupt() { acknowledge(TIMER_FLAG); }
+	bool is_TIMER_interrupt() const { return IF & TIMER_FLAG; }
+	void enable_SERIAL_interrupt() { request(SERIAL_FLAG); }
+	void disable_SERIAL_interrupt() { acknowledge(SERIAL_FLAG); }
+	bool is_SERIAL_interrupt() const { return IF & SERIAL_FLAG; }
+	void enable_JOYPAD_interrupt() { request(JOYPAD_FLAG); }
+	void disable_JOYPAD_interrupt() { acknowledge(JOYPAD_FLAG); }
+	bool is_JOYPAD_interrupt() const { return IF & JOYPAD_FLAG; }
+};
@@ -0,0 +1,169 @@
+#pragma once
+#include <stdint.h>
+
+// Lookup tables for the 8-bit ALU operations, generated by the compiler.
+//
+// Rotates, shifts and DAA: each entry is the result byte with the carry
+// out in bit 8 (ALU_CARRY); Z comes from the result, and N and H are fixed
+// by the instruction, so the CPU sets all four flags from one entry.
+//
+// ADD, SUB/CP, INC and DEC: each entry is the F byte the instruction
+// leaves (ALU_FLAG_*, low nibble clear); the result itself is one add or
+// subtract. INC and DEC leave C as it was, so their entries never set it.
+//
+// ADC and SBC stay arithmetic. Their flags also depend on the carry in,
+// so a table would be [carry][a][b]: 128KB on top of the 128KB for ADD
+// and SUB, for instructions the games run far less often, and the CPU
+// would wait on the previous flags before it could even index it.
+
+const uint16_t ALU_CARRY = 0x100;
+
+// F register bits
+const uint8_t ALU_FLAG_Z = 0x80;
+const uint8_t ALU_FLAG_N = 0x40;
+const uint8_t ALU_FLAG_H = 0x20;
+const uint8_t ALU_FLAG_C = 0x10;
+
+// CB-prefixed rotates and shifts, in opcode order (bits 5-3 of CB 00-3F)
+enum ShiftOp { SHIFT_RLC, SHIFT_RRC, SHIFT_RL, SHIFT_RR, SHIFT_SLA, SHIFT_SRA, SHIFT_SWAP, SHIFT_SRL };
+
+constexpr uint16_t alu_entry(unsigned result, bool carry) {
+    return static_cast<uint16_t>((result & 0xFF) | (carry ? ALU_CARRY : 0));
+}
+
+constexpr uint16_t shift_entry(int op, bool carry_in, uint8_t value) {
+    switch (op) {
+        case SHIFT_RLC: return alu_entry((value << 1) | (value >> 7), value & 0x80);
+        case SHIFT_RRC: return alu_entry((value >> 1) | (value << 7), value & 0x01);
+        case SHIFT_RL: return alu_entry((value << 1) | carry_in, value & 0x80);
+        case SHIFT_RR: return alu_entry((value >> 1) | (carry_in << 7), value & 0x01);
+        case SHIFT_SLA: return alu_entry(value << 1, value & 0x80);
+        case SHIFT_SRA: return alu_entry((value & 0x80) | (value >> 1), value & 0x01);
+        case SHIFT_SWAP: return alu_entry((value << 4) | (value >> 4), false);
+        default: return alu_entry(value >> 1, value & 0x01); // SHIFT_SRL
+    }
+}
+
+// DAA after an add (n = false) or subtract, given the H and C flags
+constexpr uint16_t daa_entry(bool n, bool h, bool c, uint8_t a) {
+    unsigned correction = 0;
+    bool carry = false;
+    if (n) {
+        if (c) {
+            correction |= 0x60;
+            carry = true;
+        }
+        if (h) {
+            correction |= 0x06;
+        }
+        return alu_entry(a - correction, carry);
+    }
+    if (h || (a & 0x0F) > 0x09) {
+        correction |= 0x06;
+    }
+    if (c || a > 0x99) {
+        correction |= 0x60;
+        carry = true;
+    }
+    return alu_entry(a + correction, carry);
+}
+
+constexpr uint8_t flag_byte(bool z, bool n, bool h, bool c) {
+    return (z ? ALU_FLAG_Z : 0) | (n ? ALU_FLAG_N : 0) | (h ? ALU_FLAG_H : 0) | (c ? ALU_FLAG_C : 0);
+}
+
+constexpr uint8_t add_flags(uint8_t a, uint8_t b) {
+    return flag_byte(static_cast<uint8_t>(a + b) == 0, false, (a & 0x0F) + (b & 0x0F) > 0x0F, a + b > 0xFF);
+}
+
+constexpr uint8_t sub_flags(uint8_t a, uint8_t b) {
+    return flag_byte(a == b, true, (a & 0x0F) < (b & 0x0F), a < b);
+}
+
+constexpr uint8_t inc_flags(uint8_t value) {
+    return flag_byte(value == 0xFF, false, (value & 0x0F) == 0x0F, false);
+}
+
+constexpr uint8_t dec_flags(uint8_t value) {
+    return flag_byte(value == 0x01, true, (value & 0x0F) == 0x00, false);
+}
+
+// [op][carry in][value]; the carry in only matters for RL and RR
+struct ShiftTable {
+    uint16_t entries[8][2][256];
+};
+
+// [N << 2 | H << 1 | C][A]
+struct DaaTable {
+    uint16_t entries[8][256];
+};
+
+// [a][b]: flags of a + b (ADD) or a - b (SUB, CP)
+struct BinaryFlagTable {
+    uint8_t entries[256][256];
+};
+
+// [old value]: flags of INC or DEC, C clear
+struct UnaryFlagTable {
+    uint8_t entries[256];
+};
+
+constexpr ShiftTable make_shift_table() {
+    ShiftTable table{};
+    for (int op = 0; op < 8; op++) {
+        for (int carry = 0; carry < 2; carry++) {
+            for (int value = 0; value < 256; value++) {
+                table.entries[op][carry][value] = shift_entry(op, carry, static_cast<uint8_t>(value));
+            }
+        }
+    }
+    return table;
+}
+
+constexpr DaaTable make_daa_table() {
+    DaaTable table{};
+    for (int flags = 0; flags < 8; flags++) {
+        for (int a = 0; a < 256; a++) {
+            table.entries[flags][a] = daa_entry(flags & 4, flags & 2, flags & 1, static_cast<uint8_t>(a));
+        }
+    }
+    return table;
+}
+
+constexpr BinaryFlagTable make_binary_flag_table(bool subtract) {
+    BinaryFlagTable table{};
+    for (int a = 0; a < 256; a++) {
+        for (int b = 0; b < 256; b++) {
+            table.entries[a][b] = subtract ? sub_flags(a, b) : add_flags(a, b);
+        }
+    }
+    return table;
+}
+
+constexpr UnaryFlagTable make_unary_flag_table(bool decrement) {
+    UnaryFlagTable table{};
+    for (int value = 0; value < 256; value++) {
+        table.entries[value] = decrement ? dec_flags(value) : inc_flags(value);
+    }
+    return table;
+}
+
+inline constexpr ShiftTable SHIFT_TABLE = make_shift_table();
+inline constexpr DaaTable DAA_TABLE = make_daa_table();
+inline constexpr BinaryFlagTable ADD_FLAGS = make_binary_flag_table(false);
+inline constexpr BinaryFlagTable SUB_FLAGS = make_binary_flag_table(true);
+inline constexpr UnaryFlagTable INC_FLAGS = make_unary_flag_table(false);
+inline constexpr UnaryFlagTable DEC_FLAGS = make_unary_flag_table(true);
+
+static_assert(SHIFT_TABLE.entries[SHIFT_RLC][0][0x80] == (0x01 | ALU_CARRY), "RLC moves bit 7 to bit 0 and C");
+static_assert(SHIFT_TABLE.entries[SHIFT_RR][1][0x01] == (0x80 | ALU_CARRY), "RR rotates through C");
+static_assert(SHIFT_TABLE.entries[SHIFT_SRA][0][0x81] == (0xC0 | ALU_CARRY), "SRA keeps bit 7");
+static_assert(SHIFT_TABLE.entries[SHIFT_SWAP][1][0xA5] == 0x5A, "SWAP clears C");
+static_assert(DAA_TABLE.entries[0][0x9A] == (0x00 | ALU_CARRY), "99 + 1 adjusts to 00, carry");
+static_assert(DAA_TABLE.entries[4 | 2][0x0F] == 0x09, "10 - 1 adjusts to 09");
+static_assert(ADD_FLAGS.entries[0x0F][0x01] == ALU_FLAG_H, "0F + 01 carries out of bit 3");
+static_assert(ADD_FLAGS.entries[0x80][0x80] == (ALU_FLAG_Z | ALU_FLAG_C), "80 + 80 wraps to 00, carry");
+static_assert(SUB_FLAGS.entries[0x10][0x01] == (ALU_FLAG_N | ALU_FLAG_H), "10 - 01 borrows from bit 4");
+static_assert(SUB_FLAGS.entries[0x42][0x42] == (ALU_FLAG_Z | ALU_FLAG_N), "CP of equal values sets Z");
+static_assert(INC_FLAGS.entries[0xFF] == (ALU_FLAG_Z | ALU_FLAG_H), "INC of FF wraps to 00");
+static_assert(DEC_FLAGS.entries[0x01] == (ALU_FLAG_Z | ALU_FLAG_N), "DEC of 01 gives 00");
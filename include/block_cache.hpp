@@ -0,0 +1,80 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+class Bus;
+
+// One pre-decoded instruction inside a basic block
+struct DecodedInstruction {
+    uint32_t instruction;   // the three fetched bytes, as returned by CPU::fetch_instruction
+    uint16_t pc;            // address of the opcode
+    uint8_t handler_index;  // HandlerIndex of the execute_* handler
+    uint8_t dispatch_index; // what CPU::run dispatches on: handler_index, or a fused pair starting here
+    uint8_t length;         // instruction length in bytes
+    uint8_t cycles;         // base M-cycles (not-taken timing for conditional branches)
+};
+
+// Straight-line run of instructions ending at the first control-flow
+// instruction (or at the instruction limit)
+struct BasicBlock {
+    uint16_t start_pc;
+    uint16_t end_pc; // one past the last instruction byte
+    std::vector<DecodedInstruction> instructions;
+    uint32_t hits = 0;       // times the CPU entered the block at start_pc
+    void *native = nullptr;  // compiled entry point (ENABLE_JIT builds only)
+    bool idle_loop = false;  // polling loop that branches back to start_pc, see is_idle_loop()
+};
+
+/**
+ * Cache of decoded basic blocks, keyed by start PC and filled lazily by the
+ * CPU. ROM-resident blocks live forever (there is no MBC yet, so the PC is
+ * the whole key). Blocks in VRAM, WRAM and HRAM are dropped when the bus
+ * reports a write to one of their bytes.
+ */
+class BlockCache {
+private:
+    // Two-level table from PC to block, pages allocated on first use
+    BasicBlock **blocks[256];
+    // Blocks overlapping each 256-byte page, for write invalidation
+    std::vector<BasicBlock *> page_blocks[256];
+    // Invalidated blocks, freed on the next lookup (the CPU may still be
+    // stepping through one of them when it is invalidated)
+    std::vector<BasicBlock *> retired;
+    uint32_t generation;
+    Bus *bus; // told which pages hold code, so it can route their writes here
+
+    void add_to_page(uint8_t page, BasicBlock *block);
+    void remove_from_page(uint8_t page, BasicBlock *block);
+
+    void retire_block(BasicBlock *block);
+
+public:
+    static const int MAX_BLOCK_INSTRUCTIONS = 64;
+
+    uint64_t blocks_decoded;
+    uint64_t blocks_invalidated;
+
+    BlockCache();
+    ~BlockCache();
+
+    // Code at this address may be cached
+    static bool is_cacheable(uint16_t addr) {
+        return addr < 0xA000 ||                     // ROM, VRAM
+               (addr >= 0xC000 && addr <= 0xDFFF) || // WRAM
+               (addr >= 0xFF80 && addr <= 0xFFFE);   // HRAM
+    }
+
+    void connect_bus(Bus *bus);
+
+    BasicBlock *lookup(uint16_t pc);
+    BasicBlock *insert(BasicBlock *block);
+
+    // Called by the bus on writes: drop every block containing addr
+    bool is_code(uint16_t addr) const { return !page_blocks[addr >> 8].empty(); }
+    void invalidate(uint16_t addr);
+
+    // Bumped on every invalidation, so the CPU can tell when a block it is
+    // replaying may have been freed
+    uint32_t get_generation() const { return generation; }
+    const uint32_t *get_generation_address() const { return &generation; }
+};
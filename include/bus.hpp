@@ -0,0 +1,150 @@
+#pragma once
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+
+#include "input.hpp"
+#include "block_cache.hpp"
+#include "tile_cache.hpp"
+#include "sprite_buckets.hpp"
+#include "trace.hpp"
+
+class Timer;
+class Scheduler;
+class InterruptHandler;
+
+/**
+ * The memory bus: owns the 64KB backing store and applies the access rules
+ * of each region for the CPU. The common accesses are inlined here; the
+ * rest goes through read_mem_slow / write_mem_slow.
+ */
+class Bus {
+private:
+    uint8_t mem[0x10000]; // 64KB of memory
+    Input *input;
+    BlockCache *block_cache;
+    TileCache *tile_cache; // PPU's decoded tiles, marked dirty on tile data writes
+    SpriteBuckets *sprite_buckets; // PPU's per-line sprite lists, rebuilt after OAM changes
+    Timer *timer;
+    Scheduler *scheduler;
+    InterruptHandler *IH; // holds IF (0xFF0F) and IE (0xFFFF)
+#ifdef ENABLE_TRACE
+    Tracer *tracer;
+#endif
+#ifdef ENABLE_JIT
+    // Compiled blocks read the page tables and HRAM in mem directly
+    friend class Jit;
+#endif
+
+    // Host pointer to each 256-byte page for accesses that need no special
+    // handling (nullptr: go through read_mem_slow / write_mem_slow)
+    uint8_t *read_pages[256];
+    uint8_t *write_pages[256];
+    void build_page_tables();
+    uint8_t *direct_write_page(uint8_t page);
+
+    uint8_t read_mem_slow(uint16_t addr);
+    void write_mem_slow(uint16_t addr, uint8_t data);
+
+    // Drop cached code overlapping a write to VRAM, WRAM or HRAM
+    void invalidate_code(uint16_t addr) {
+        if (block_cache && block_cache->is_code(addr)) {
+            block_cache->invalidate(addr);
+        }
+    }
+    // Mark the decoded tile overlapping a write to VRAM
+    void invalidate_tile(uint16_t addr) {
+        if (TileCache::is_tile_data(addr) && tile_cache) {
+            tile_cache->invalidate(addr);
+        }
+    }
+
+public:
+    static const uint16_t VRAM_START = 0x8000;
+    static const uint16_t VRAM_SIZE = 0x2000;
+    static const uint16_t OAM_START = 0xFE00;
+    static const uint16_t OAM_SIZE = 0xA0;
+    static const uint64_t DMA_CYCLES = 160; // M-cycles from the 0xFF46 write to a filled OAM
+
+    bool transfer_pending; // OAM DMA started and not completed yet
+    uint8_t dma_buffer[OAM_SIZE]; // DMA buffer for 0xFE00 - 0xFE9F
+
+    Bus();
+
+    void connect_input(Input *input);
+    void connect_block_cache(BlockCache *block_cache);
+    void connect_tile_cache(TileCache *tile_cache);
+    void connect_sprite_buckets(SpriteBuckets *sprite_buckets);
+    void connect_timer(Timer *timer);
+    void connect_scheduler(Scheduler *scheduler);
+    void connect_interrupt_handler(InterruptHandler *IH);
+#ifdef ENABLE_TRACE
+    void connect_tracer(Tracer *tracer) { this->tracer = tracer; }
+#endif
+
+    // HRAM (0xFF80 - 0xFFFE) shares page 0xFF with I/O and IE, so it has no
+    // page table entry and is checked inline instead
+    static bool is_hram(uint16_t addr) { return addr >= 0xFF80 && addr != 0xFFFF; }
+
+    // CPU view of memory
+    uint8_t read_mem(uint16_t addr) {
+        uint8_t *page = read_pages[addr >> 8];
+        if (page) {
+            return page[addr & 0xFF];
+        }
+        return is_hram(addr) ? mem[addr] : read_mem_slow(addr);
+    }
+    void write_mem(uint16_t addr, uint8_t data) {
+#ifdef ENABLE_TRACE
+        if (tracer) {
+            tracer->note_write(addr, data);
+        }
+#endif
+        uint8_t *page = write_pages[addr >> 8];
+        if (page) {
+            page[addr & 0xFF] = data;
+            invalidate_tile(addr); // tile data pages stay direct
+        } else if (is_hram(addr)) {
+            mem[addr] = data;
+            invalidate_code(addr);
+        } else {
+            write_mem_slow(addr, data);
+        }
+    }
+
+    // The backing store as is, with no access rules: ROM loading and the
+    // registers that the PPU and timer update themselves. VRAM written
+    // this way is not seen by the tile cache.
+    uint8_t read_raw(uint16_t addr) const { return mem[addr]; }
+    void write_raw(uint16_t addr, uint8_t data) { mem[addr] = data; }
+
+    // Stack operations: the same access rules as any other read or write,
+    // since SP can point anywhere (OAM, I/O, IE)
+    void push_stack(uint16_t sp, uint16_t data) {
+        write_mem(static_cast<uint16_t>(sp - 1), static_cast<uint8_t>(data >> 8)); // Store MSB of rr
+        write_mem(static_cast<uint16_t>(sp - 2), static_cast<uint8_t>(data & 0xFF)); // Store LSB of rr
+    }
+    uint16_t pop_stack(uint16_t sp) {
+        uint8_t lsb = read_mem(sp);
+        uint8_t msb = read_mem(static_cast<uint16_t>(sp + 1));
+        return (static_cast<uint16_t>(msb) << 8) | lsb;
+    }
+
+    // Direct views of VRAM (0x8000 - 0x9FFF) and OAM (0xFE00 - 0xFE9F) for the PPU
+    uint8_t *get_vram() { return &mem[VRAM_START]; }
+    uint8_t *get_oam() { return &mem[OAM_START]; }
+
+    // Whole-memory comparison, for differential checking
+    bool same_memory(const Bus &other) const { return memcmp(mem, other.mem, sizeof(mem)) == 0; }
+
+    // Called by the block cache when a page gains its first cached block or
+    // loses its last one. Writes to watched pages take the slow path, which
+    // invalidates the overlapping blocks.
+    void set_page_watched(uint8_t page, bool watched);
+
+    void fill_buffer(uint16_t addr);
+    // Copy the DMA buffer to OAM (EVENT_DMA, or right away with no scheduler)
+    void dma_transfer();
+};
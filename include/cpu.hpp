@@ -3,8 +3,12 @@
 #include <stdlib.h>
 #include <stdio.h>
 
-#include "mmu.hpp"
+#include "bus.hpp"
 #include "InterruptHandler.hpp"
+#include "block_cache.hpp"
+#include "jit.hpp"
+#include "profiler.hpp"
+#include "trace.hpp"
 
 const int A_REGISTER = 7;
 const int B_REGISTER = 0;
@@ -15,12 +19,19 @@ const int FLAGS_REGISTER = 6;
 const int H_REGISTER = 4;
 const int L_REGISTER = 5;
 
+// 16-bit register pairs, in their 2-bit encoding: high register at
+// regs[2 * pair], low register at regs[2 * pair + 1]
+const int BC_PAIR = 0;
+const int DE_PAIR = 1;
+const int HL_PAIR = 2;
+
 // flag bit positions
 const int Z_FLAG_BIT = 7;
 const int N_FLAG_BIT = 6;
 const int H_FLAG_BIT = 5;
 const int C_FLAG_BIT = 4;
 
+
 enum INSTRUCTION {
     // Jai
     LD_20,
@@ -134,9 +145,50 @@ enum INSTRUCTION {
     EI_124
 };
 
+// Every decode_*/execute_* pair, in decode priority order (first match wins)
+#define CPU_INSTRUCTION_LIST(X) \
+    X(LD, 20) X(LD, 21) X(LD, 22) X(LD, 23) X(LD, 24) X(LD, 25) \
+    X(LD, 26) X(LD, 27) X(LD, 28) X(LD, 29) X(LD, 30) X(LD, 31) \
+    X(LD, 32) X(LD, 33) X(LD, 34) X(LD, 35) X(LD, 36) X(LD, 37) \
+    X(LD, 38) X(LD, 39) X(LD, 40) X(LD, 41) X(PUSH, 42) X(POP, 43) \
+    X(LD, 44) X(ADD, 45) X(ADD, 46) X(ADD, 47) X(ADC, 48) X(ADC, 49) \
+    X(ADC, 50) X(SUB, 51) X(SUB, 52) X(SUB, 53) X(SBC, 54) X(SBC, 55) \
+    X(SBC, 56) X(CP, 57) X(CP, 58) X(CP, 59) X(INC, 60) X(INC, 61) \
+    X(DEC, 62) X(DEC, 63) X(AND, 64) X(AND, 65) X(AND, 66) X(OR, 67) \
+    X(OR, 68) X(OR, 69) X(XOR, 70) X(XOR, 71) X(XOR, 72) X(CCF, 73) \
+    X(SCF, 74) X(DAA, 75) X(CPL, 76) X(INC, 77) X(DEC, 78) X(ADD, 79) \
+    X(ADD, 80) X(RLCA, 82) X(RRCA, 83) X(RLA, 84) X(RRA, 85) X(RLC, 86) \
+    X(RLC, 87) X(RRC, 88) X(RRC, 89) X(RL, 90) X(RL, 91) X(RR, 92) \
+    X(RR, 93) X(SLA, 94) X(SLA, 95) X(SRA, 96) X(SRA, 97) X(SWAP, 98) \
+    X(SWAP, 99) X(SRL, 100) X(SRL, 101) X(BIT, 102) X(BIT, 103) X(RES, 104) \
+    X(RES, 105) X(SET, 106) X(SET, 107) X(JP, 109) X(JP, 110) X(JP, 111) \
+    X(JR, 113) X(JR, 114) X(CALL, 116) X(CALL, 117) X(RET, 119) X(RET, 120) \
+    X(RETI, 121) X(RST, 122) X(HALT, 123) X(STOP, 123) X(DI, 123) X(EI, 124) \
+    X(NOP, 125)
+
+// Index of each execute_* handler in CPU_INSTRUCTION_LIST
+enum HandlerIndex : uint8_t {
+#define HANDLER_INDEX(mnemonic, number) HANDLER_##mnemonic##_##number,
+    CPU_INSTRUCTION_LIST(HANDLER_INDEX)
+#undef HANDLER_INDEX
+    HANDLER_COUNT // also used for unimplemented opcodes
+};
+
+// Use labels-as-values dispatch in CPU::run where the compiler supports it.
+// Define CPU_NO_COMPUTED_GOTO to force the portable switch loop.
+#if defined(__GNUC__) && !defined(CPU_NO_COMPUTED_GOTO)
+#define CPU_USE_COMPUTED_GOTO
+#endif
+
+class CPU;
+
+// Pointer to one of the CPU::execute_* handlers
+typedef void (CPU::*ExecuteHandler)(uint32_t instruction);
+
 class CPU {
 private:
     uint64_t cycles; // Cycle Counter
+    uint64_t run_target; // run() returns once cycles reaches this
 
     uint8_t regs[8]; // 0: B, 1: C, 2: D, 3: E, 4: H, 5: L, 6: F, 7: A
     uint16_t pc; // Program Counter
@@ -145,9 +197,90 @@ private:
     bool ime; // Interrupt Master Enable
     bool halted;
 
-    MMU *mmu;
+    // Lazy flags: F is kept in pieces that are each a single store to
+    // update and a single load to test. Z and H are derived from the last
+    // ALU result and operands only when read. regs[FLAGS_REGISTER] holds
+    // the packed byte only after materialize_flags() (get_af(), the
+    // tracer), plus the low nibble, which POP AF can set.
+    uint8_t flag_result; // Z is set when this is 0
+    uint8_t flag_half;   // H is bit 4 (lhs ^ rhs ^ result of an add or subtract, or F >> 1)
+    bool flag_n;
+    bool flag_c;
+    // Flags of an 8-bit ALU operation, with or without C
+    void set_alu_flags(uint8_t result, bool n, uint8_t half, bool c) {
+        flag_result = result;
+        flag_n = n;
+        flag_half = half;
+        flag_c = c;
+    }
+    void set_alu_flags(uint8_t result, bool n, uint8_t half) {
+        flag_result = result;
+        flag_n = n;
+        flag_half = half;
+    }
+    // The same from an F byte of the flag tables in alu_tables.hpp, with
+    // or without C. Z still comes from result.
+    void set_table_flags(uint8_t result, bool n, uint8_t f) {
+        set_alu_flags(result, n, f >> (H_FLAG_BIT - 4), (f >> C_FLAG_BIT) & 1);
+    }
+    void set_table_flags_keep_c(uint8_t result, bool n, uint8_t f) {
+        set_alu_flags(result, n, f >> (H_FLAG_BIT - 4));
+    }
+    void materialize_flags();
+    void unpack_flags();
+    // CB rotate/shift of value (a ShiftOp, see alu_tables.hpp); sets the flags
+    uint8_t shift(int op, uint8_t value);
+
+    Bus *bus;
 	InterruptHandler* IH;
 
+    // Opcode dispatch tables, indexed by the first opcode byte (or the byte
+    // following the 0xCB prefix). Built once from the decode_* predicates.
+    static bool dispatch_tables_built;
+    static ExecuteHandler opcode_table[256];
+    static ExecuteHandler cb_opcode_table[256];
+    static uint8_t opcode_index[256];
+    static uint8_t cb_opcode_index[256];
+    static const char *opcode_names[256];
+    static const char *cb_opcode_names[256];
+    void build_dispatch_tables();
+
+    // Pre-decoded blocks replayed by run(). The cursor points into the block
+    // being executed and is only trusted while the cache generation matches.
+    BlockCache *block_cache;
+    const DecodedInstruction *block_op;
+    const DecodedInstruction *block_end;
+    uint32_t block_generation;
+    BasicBlock *decode_block(uint16_t start_pc);
+    void enter_block();
+
+    // Idle-loop skipping: the polling loop last entered in this run() slice,
+    // and the cycle count at that entry
+    const BasicBlock *idle_block;
+    uint32_t idle_generation;
+    uint64_t idle_entry_cycles;
+    bool idle_loop_reads_timer(const BasicBlock *block);
+    void skip_idle_loop(const BasicBlock *block);
+    uint8_t next_instruction(uint32_t &instruction);
+
+#ifdef ENABLE_JIT
+    // Compiles hot blocks; block_native is the entry point of the block the
+    // cursor was last positioned on, if it has one, and block_start its
+    // first instruction. Compiled code can start at any instruction.
+    friend class Jit;
+    Jit *jit;
+    void *block_native;
+    const DecodedInstruction *block_start;
+    void run_native_block();
+#endif
+
+#ifdef ENABLE_PROFILER
+    Profiler *profiler;
+#endif
+#ifdef ENABLE_TRACE
+    Tracer *tracer;
+#endif
+
     // #### FUNCTION DECLARATIONS ####
     // Get a specific flag bit
     bool get_flag(int flag_bit);
@@ -158,30 +291,80 @@ private:
 
 public:
 
+    // Fast-forward side-effect-free polling loops to the end of the run()
+    // slice (on by default), and the M-cycles skipped that way
+    bool skip_idle_loops;
+    uint64_t idle_cycles_skipped;
+
     CPU();
 
     uint32_t fetch_instruction();
 
-    void connect_mmu(MMU *mmu);
+    void connect_bus(Bus *bus);
+    void connect_block_cache(BlockCache *block_cache);
+#ifdef ENABLE_JIT
+    void connect_jit(Jit *jit);
+#endif
+#ifdef ENABLE_PROFILER
+    void connect_profiler(Profiler *profiler);
+#endif
+#ifdef ENABLE_TRACE
+    void connect_tracer(Tracer *tracer);
+#endif
   
 	void connect_interrupt_handler(InterruptHandler* IH);
 	uint64_t get_cycles() const { return cycles; }
+    bool is_halted() const { return halted; }
 
     uint16_t get_pc();
     uint16_t get_sp();
     // Get a 16-bit register value
-    uint16_t get_hl();
-    uint16_t get_bc();
-    uint16_t get_de();
+    uint16_t get_pair(int pair) const {
+        return (static_cast<uint16_t>(regs[2 * pair]) << 8) | regs[2 * pair + 1];
+    }
+    uint16_t get_hl() const { return get_pair(HL_PAIR); }
+    uint16_t get_bc() const { return get_pair(BC_PAIR); }
+    uint16_t get_de() const { return get_pair(DE_PAIR); }
     uint16_t get_af();
     // Set a 16-bit register value
-    void set_hl(uint16_t val);
-    void set_bc(uint16_t val);
-    void set_de(uint16_t val);
+    void set_pair(int pair, uint16_t val) {
+        regs[2 * pair] = static_cast<uint8_t>(val >> 8);
+        regs[2 * pair + 1] = static_cast<uint8_t>(val);
+    }
+    void set_hl(uint16_t val) { set_pair(HL_PAIR, val); }
+    void set_bc(uint16_t val) { set_pair(BC_PAIR, val); }
+    void set_de(uint16_t val) { set_pair(DE_PAIR, val); }
     void set_af(uint16_t val);
 
     void handle_interrupts();
 
+    // Execute a fetched instruction through the dispatch tables.
+    // Returns false if the opcode is not implemented.
+    bool execute_instruction(uint32_t instruction);
+    const char *get_instruction_name(uint32_t instruction);
+
+    // Instruction length in bytes and base M-cycles (not-taken timing for
+    // conditional branches), indexed by opcode
+    static uint8_t get_instruction_length(uint8_t opcode);
+    static uint8_t get_base_cycles(uint32_t instruction);
+
+    // Threaded interpreter loop: fetch and execute instructions until the
+    // cycle counter reaches target_cycles or limit_run() ends the slice
+    // (always at least one instruction). While halted, the cycle counter
+    // jumps straight to target_cycles instead.
+    // Replays cached blocks when a BlockCache is connected.
+    // Returns false if an unimplemented opcode was hit.
+    bool run(uint64_t target_cycles);
+
+    // Bring the end of the current run() slice forward to target (0: stop
+    // after the current instruction). EI and RETI do this themselves, so a
+    // pending interrupt is taken before the next instruction.
+    void limit_run(uint64_t target) {
+        if (target < run_target) {
+            run_target = target;
+        }
+    }
+
     // Decode & execute declarations
     // Jai
     bool decode_LD_20(uint32_t instruction);
@@ -0,0 +1,82 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include "cpu.hpp"
+#include "bus.hpp"
+#include "ppu.hpp"
+#include "input.hpp"
+#include "InterruptHandler.hpp"
+#include "timer.hpp"
+#include "block_cache.hpp"
+#include "scheduler.hpp"
+#ifdef ENABLE_JIT
+#include "jit.hpp"
+#endif
+#ifdef ENABLE_PROFILER
+#include "profiler.hpp"
+#endif
+#ifdef ENABLE_TRACE
+#include "trace.hpp"
+#endif
+
+// Bits returned by Emulator::service_events()
+const uint32_t EMU_VBLANK = 1 << 0;     // a complete frame is in ppu.pixelsToRender
+const uint32_t EMU_HOST_FRAME = 1 << 1; // one host frame of emulated time has passed
+
+/**
+ * The machine without a frontend: every component wired together, ROM
+ * loading and the event loop. Nothing here depends on SDL; the window,
+ * input and frame pacing belong to whichever frontend drives it.
+ *
+ * A frontend alternates service_events(), reacting to the bits it returns,
+ * and run_cpu(). Large (the PPU keeps several framebuffers), so allocate it
+ * on the heap.
+ */
+class Emulator {
+public:
+    Bus bus;
+    Input input;
+    InterruptHandler IH;
+    BlockCache block_cache;
+    Scheduler scheduler;
+    Timer timer;
+    PPU ppu;
+    CPU cpu;
+#ifdef ENABLE_JIT
+    Jit jit;
+#endif
+#ifdef ENABLE_PROFILER
+    Profiler profiler;
+#endif
+#ifdef ENABLE_TRACE
+    Tracer tracer;
+#endif
+
+    uint64_t frames; // VBlanks so far
+
+    Emulator();
+
+    // Load up to 32KB of a ROM at 0x0000 (and boot.bin over it when
+    // ENABLE_BOOT is defined)
+    bool load_rom(const std::string &rom_path);
+
+    // Service every event due now. Returns EMU_* bits for what happened.
+    uint32_t service_events();
+
+    // Take a pending interrupt and run the CPU up to the next event.
+    // Returns false if an unimplemented opcode was hit.
+    bool run_cpu();
+
+#ifdef ENABLE_TRACE
+    // Stream a binary record of every instruction to path until
+    // stop_trace() (or destruction)
+    bool start_trace(const std::string &path);
+    void stop_trace();
+#endif
+
+    // name itself if that file exists, otherwise name under ./games/
+    static std::string find_rom(const std::string &name);
+
+private:
+    bool load_file(const std::string &path);
+};
@@ -1,14 +1,7 @@
 #pragma once
 #include <SDL.h>
 #include <string>
-#include "cpu.hpp"
-#include "mmap.hpp"
-#include "mmu.hpp"
-#include "ppu.hpp"
-#include "RAM.hpp"
-#include "input.hpp"
-#include "InterruptHandler.hpp"
-#include "timer.hpp"
+#include "emulator.hpp"
 
 const int TARGET_FPS = 60;
 const float TARGET_FRAME_TIME_MS = 1000.0f / TARGET_FPS;
@@ -20,16 +13,7 @@ public:
     ~GheithBoy();
 
 private:
-    bool load_boot(MMAP *mmap);
-    bool load_rom(MMAP *mmap, const std::string &rom_path);
-    CPU *cpu;
-    Input *input;
-    MMAP *mmap;
-    MMU *mmu;
-    PPU *ppu;
-    RAM *ram;
-    InterruptHandler *IH;
-    Timer* timer;
+    Emulator *emu;
     SDL_Window *window;
     SDL_Surface *window_surface;
     const int SCALE_FACTOR = 4;
@@ -37,4 +21,6 @@ private:
     const int WINDOW_HEIGHT = 144 * SCALE_FACTOR;
 
     void handle_input(const SDL_Event &event);
+    bool poll_events();
+    void render_frame();
 };
@@ -16,6 +16,6 @@ public:
     // Function to update button state (called from SDL event loop)
     void set_button_state(uint8_t button_index, bool pressed);
 
-    // Function called by MMU to get the JOYP register value
+    // Function called by the Bus to get the JOYP register value
     uint8_t get_joyp_state(uint8_t mmap_joyp_value) const;
 };
\ No newline at end of file
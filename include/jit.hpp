@@ -0,0 +1,157 @@
+#pragma once
+#ifdef ENABLE_JIT
+
+#if !defined(__x86_64__)
+#error "ENABLE_JIT needs an x86-64 host"
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+#include "block_cache.hpp"
+#include "InterruptHandler.hpp"
+#include "scheduler.hpp"
+#include "timer.hpp"
+
+class CPU;
+class Bus;
+
+// Compiled block entry point. Runs instructions of the block from index
+// until it ends, the cycle counter reaches the CPU's run target, or the
+// cache generation changes (code was overwritten). A block that jumps back
+// to its own start keeps looping under the same checks. Returns the index
+// of the next instruction in the low 32 bits (the block's length once it
+// ran to the end) and the jumps back to the start in the high 32 bits.
+typedef uint64_t (*JitCode)(CPU *cpu, const uint32_t *generation, uint32_t index);
+
+/**
+ * Experimental x86-64 backend for hot basic blocks (build with ENABLE_JIT).
+ * Whole-machine runs are not faster than the interpreter yet (see README).
+ *
+ * Blocks are compiled once the CPU has entered them HOT_THRESHOLD times.
+ * Loads and stores, the 8-bit ALU, INC/DEC, 16-bit loads and arithmetic,
+ * BIT/RES/SET r and the jumps and returns are emitted inline, with the
+ * cycle counter and run target held in registers. Memory accesses go
+ * through the bus page tables inline and call out to the bus only for
+ * pages without a direct pointer (and tile data writes). The remaining
+ * instructions (CALL, PUSH, rotates, EI, HALT, ...) are direct calls into
+ * their CPU::execute_* handler. After each instruction the generated code
+ * checks the cycle budget, and after anything that may have written to
+ * cached code it checks whether the block cache was invalidated. A slice
+ * that ends inside a block resumes in compiled code through a table of
+ * instruction offsets, and a block that branches back to its own start
+ * loops without returning to the CPU.
+ *
+ * In differential mode every native run is replayed through the
+ * interpreter from a snapshot of the CPU, bus, interrupt registers, timer
+ * and scheduler, and the resulting states are compared.
+ */
+class Jit {
+private:
+    uint8_t *arena;
+    size_t arena_size;
+    size_t arena_used;
+    bool arena_executable; // cleared if the arena could not be made executable again
+
+    // Byte offsets of the CPU fields touched by generated code
+    int32_t regs_offset;
+    int32_t pc_offset;
+    int32_t sp_offset;
+    int32_t cycles_offset;
+    int32_t run_target_offset;
+    int32_t flag_result_offset;
+    int32_t flag_half_offset;
+    int32_t flag_n_offset;
+    int32_t flag_c_offset;
+    int32_t ime_offset;
+    int32_t bus_offset;
+    // and of the Bus fields
+    int32_t read_pages_offset;
+    int32_t write_pages_offset;
+    int32_t mem_offset;
+    void find_offsets(CPU *cpu);
+
+    std::vector<uint8_t> code; // staging buffer for the block being compiled
+    // Jumps to the exit taken after some instructions: rel32 position, count
+    std::vector<std::pair<size_t, uint32_t>> exits;
+    bool wrote_memory; // the instruction being emitted may have invalidated code
+    bool stored_pc;    // ... or is a jump that stored the pc itself
+    int32_t loop_pc;   // start of the block being compiled, -1 if it must not loop
+    size_t loop_start; // its first instruction in code
+    std::vector<size_t> op_starts; // each instruction's code, for entering mid-block
+    std::vector<size_t> finish_jumps; // rel32 positions of jumps to the end of the block
+
+    // Snapshots for differential mode
+    Bus *bus_before;
+    Bus *bus_native;
+    InterruptHandler IH_before;
+    InterruptHandler IH_native;
+    Timer timer_before;
+    Timer timer_native;
+    Scheduler scheduler_before;
+    Scheduler scheduler_native;
+
+    void emit8(uint8_t byte) { code.push_back(byte); }
+    void emit16(uint16_t value);
+    void emit32(uint32_t value);
+    void emit64(uint64_t value);
+    void emit_mem_rbx(uint8_t reg_field, int32_t disp); // ModRM [rbx + disp32]
+    void emit_rbx(uint8_t rex, std::initializer_list<uint8_t> opcode, uint8_t reg, int32_t disp);
+    void emit_rr(uint8_t opcode, uint8_t dst, uint8_t src); // 32-bit op between eax..edi
+    size_t emit_jump8(uint8_t opcode);
+    void bind8(size_t pos);
+    size_t emit_jump32(uint8_t jcc);
+    void bind32(size_t pos);
+    void emit_exit(uint8_t jcc, uint32_t executed);
+    void emit_call(const void *function);
+
+    void emit_read();  // eax = byte at ecx
+    void emit_write(); // byte at ecx = al
+    void emit_pop();   // eax = word at SP, SP += 2
+    void emit_load_pair(uint8_t reg, uint8_t pair);
+    void emit_store_pair(uint8_t reg, uint8_t pair);
+    void emit_step_pair(uint8_t pair, bool dec);
+    uint8_t emit_condition(uint8_t opcode);
+    void emit_branch(const DecodedInstruction &op, bool conditional, uint16_t target,
+                     uint8_t taken_cycles);
+    void emit_alu(uint8_t operation);
+    bool emit_native(const DecodedInstruction &op);
+
+    // Out-of-line bus accesses for pages without a direct pointer
+    static uint8_t read_slow(Bus *bus, uint16_t addr);
+    static void write_slow(CPU *cpu, uint16_t addr, uint8_t data);
+    static uint16_t pop_slow(Bus *bus, uint16_t sp);
+
+    uint32_t execute_checked(CPU *cpu, const DecodedInstruction *ops, uint32_t count, uint32_t index,
+                             JitCode native, const uint32_t *generation);
+
+public:
+    static const uint32_t HOT_THRESHOLD = 16;
+    static const size_t DEFAULT_ARENA_SIZE = 4 * 1024 * 1024;
+
+    bool differential;
+
+    uint64_t blocks_compiled;
+    uint64_t native_runs;
+    uint64_t mismatches;
+
+    Jit(size_t arena_size = DEFAULT_ARENA_SIZE);
+    ~Jit();
+
+    // Translate block into the arena and attach the entry point to it.
+    // Returns false when the arena is full or cannot be reprotected.
+    bool compile(BasicBlock *block, CPU *cpu);
+
+    // False once the arena could not be made executable again
+    bool usable() const { return arena_executable; }
+
+    // Run a compiled block (count instructions at ops) from instruction
+    // index. Returns the index the interpreter carries on from.
+    uint32_t execute(CPU *cpu, const DecodedInstruction *ops, uint32_t count, uint32_t index,
+                     void *native, const uint32_t *generation);
+};
+
+#endif // ENABLE_JIT
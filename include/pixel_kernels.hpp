@@ -0,0 +1,47 @@
+#pragma once
+#include <stdint.h>
+
+enum COLOR
+{
+    WHITE_OR_TRANSPARENT = 0,
+    LIGHT_GRAY = 1,
+    DARK_GRAY = 2,
+    BLACK = 3,
+    WINDOW_TRANSPARENT = 4,
+};
+
+/**
+ * The per-pixel loops of the renderer, in a scalar version and in SSE2 and
+ * AVX2 versions on x86. pixel_kernels() picks the best one the host CPU
+ * supports the first time it is called; every version gives the same
+ * output as the scalar one (see pixel_kernels_verify).
+ *
+ * Build with -DPIXEL_NO_SIMD (make PIXEL_NO_SIMD=1) to always use the
+ * scalar kernels.
+ */
+struct PixelKernels {
+    const char *name;
+
+    // One tile's 16 bytes of 2bpp data (two bitplane bytes per row) to a
+    // color index (0-3) per pixel, leftmost pixel first
+    void (*decode_tile)(const uint8_t *data, uint8_t pixels[8][8]);
+
+    // count color indices (0-3) through a BGP-style palette register, to
+    // one COLOR byte each
+    void (*map_palette)(const uint8_t *indices, uint8_t palette, uint8_t *out, int count);
+
+    // count COLOR bytes to ARGB8888 shades of gray (anything but the four
+    // shades is white)
+    void (*to_argb)(const uint8_t *colors, uint32_t *out, int count);
+};
+
+const PixelKernels &pixel_kernels();
+
+// Every version this build has that the host CPU can run, scalar first.
+// Returns how many were written to kernels (at most 3).
+int available_pixel_kernels(const PixelKernels *kernels[3]);
+
+// Compare k against the scalar kernels over every tile row, palette and
+// color byte. Returns false, after printing the first difference, if
+// they disagree.
+bool pixel_kernels_verify(const PixelKernels &k);
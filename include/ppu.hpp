@@ -2,20 +2,14 @@
 #include <stdint.h>
 #include <vector>
 #include <queue>
-#include "mmu.hpp"
-#include "RAM.hpp"
+#include "bus.hpp"
 #include "InterruptHandler.hpp"
+#include "scheduler.hpp"
+#include "tile_cache.hpp"
+#include "sprite_buckets.hpp"
+#include "pixel_kernels.hpp"
 #include "Sprite.hpp"
 
-enum COLOR
-{
-    WHITE_OR_TRANSPARENT = 0,
-    LIGHT_GRAY = 1,
-    DARK_GRAY = 2,
-    BLACK = 3,
-    WINDOW_TRANSPARENT = 4,
-};
-
 class Compare {
 public:
     bool operator()(Sprite* a, Sprite* b) {
@@ -28,6 +22,13 @@ class PPU
 private:
     const static int SCREEN_WIDTH = 160;
     const static int SCREEN_HEIGHT = 144;
+    const static int LINES_PER_FRAME = 154; // 144 visible + 10 VBLANK
+
+    // Mode lengths in M-cycles (OAM + VRAM + HBLANK = one line)
+    const static uint64_t OAM_CYCLES = 20;
+    const static uint64_t VRAM_CYCLES = 43;
+    const static uint64_t HBLANK_CYCLES = 51;
+    const static uint64_t LINE_CYCLES = 114;
 
     uint8_t LCDC_reg;
     uint8_t SCX_reg;
@@ -37,40 +38,65 @@ private:
     uint8_t OBP0_reg;
     uint8_t OBP1_reg;
     uint8_t BGP_reg;
-    MMU *mmu;
-    RAM *ram;
+    Bus *bus;
+    uint8_t *vram; // 0x8000 - 0x9FFF
+    uint8_t *oam;  // 0xFE00 - 0xFE9F
+    TileCache tile_cache; // tile data decoded to color indices, kept current by the bus
+    SpriteBuckets sprite_buckets; // sprites per line, kept current by the bus
+    const PixelKernels *kernels; // pixel_kernels(), looked up once
     InterruptHandler *IH;
+    Scheduler *scheduler;
 
     int mode;
     uint8_t scanLine;
-    uint64_t clock;
+    uint8_t windowLineCounter; // window row drawn next; only advances on lines that show the window
 
-    COLOR pixelData[SCREEN_HEIGHT][SCREEN_WIDTH];
-    COLOR backgroundData[SCREEN_HEIGHT][SCREEN_WIDTH];
-    COLOR windowData[SCREEN_HEIGHT][SCREEN_WIDTH];
-    COLOR spriteData[SCREEN_HEIGHT][SCREEN_WIDTH];
+    // The layers of the line being drawn, one COLOR per byte. Each row is
+    // rendered and composited within one mode 3 event, so only
+    // pixelsToRender needs the whole frame.
+    uint8_t pixelLine[SCREEN_WIDTH];
+    uint8_t backgroundLine[SCREEN_WIDTH];
+    uint8_t windowLine[SCREEN_WIDTH];
+    uint8_t spriteLine[SCREEN_WIDTH];
 
-    std::vector<Sprite> spriteBuffer;
+    // This line's sprites, copied from OAM by scanOAM in drawing priority order
+    Sprite lineSprites[SpriteBuckets::MAX_PER_LINE];
+    int lineSpriteCount;
 
 public:
+    const static uint64_t FRAME_CYCLES = LINE_CYCLES * LINES_PER_FRAME;
+
     uint32_t pixelsToRender[SCREEN_HEIGHT][SCREEN_WIDTH];
 
     PPU();
     ~PPU();
-    void connect_mmu(MMU *mmu);
-    void connect_ram(RAM *ram);
+    void connect_bus(Bus *bus);
     void connect_interrupt_handler(InterruptHandler *IH);
+    // Also schedules the end of the first OAM scan
+    void connect_scheduler(Scheduler *scheduler);
 
-    bool tick(uint64_t outsideClock);
+    // EVENT_PPU: the current mode ended at time; switch to the next one and
+    // schedule its end. Returns true when a frame is complete (VBLANK starts).
+    bool handle_event(uint64_t time);
     void update_LY();
     void update_LCDSTAT();
     void updatePixelData(uint8_t row);
     void updateRegs();
     void updateBackground(uint8_t row);
     void updateWindow(uint8_t row);
+    int bgTileNumber(uint8_t tile_index); // background/window tile map entry to TileCache tile, per LCDC bit 4
     void updateSprites(uint8_t row);
     void scanOAM(uint8_t row);
 
+    // The window layer of the line last drawn, one COLOR per byte
+    const uint8_t *window_line() const { return windowLine; }
+    // This line's sprites from the last scanOAM, in drawing priority order
+    const Sprite *line_sprites(int &count) const {
+        count = lineSpriteCount;
+        return lineSprites;
+    }
+    uint64_t sprite_bucket_rebuilds() const { return sprite_buckets.rebuilds; }
+
     uint8_t read_mem(uint16_t addr);
     void write_mem(uint16_t addr, uint8_t data);
 };
\ No newline at end of file
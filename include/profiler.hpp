@@ -0,0 +1,53 @@
+#pragma once
+#ifdef ENABLE_PROFILER
+
+#include <stdint.h>
+#include <stddef.h>
+#include <ostream>
+
+class CPU;
+
+/**
+ * Execution profile of the CPU core (build with ENABLE_PROFILER).
+ *
+ * Counts executions and emulated M-cycles per opcode, per CB-prefixed
+ * opcode and per PC. CPU::run and CPU::execute_instruction call record()
+ * once per instruction, which is just a few array increments. Cycles added
+ * outside instructions (interrupt dispatch, HALT and idle-loop skipping)
+ * are not attributed to any opcode. Native JIT blocks would bypass the
+ * counters, so the CPU does not use the JIT in profiling builds.
+ */
+class Profiler {
+private:
+    uint64_t opcode_count[256];
+    uint64_t opcode_cycles[256];
+    uint64_t cb_count[256];
+    uint64_t cb_cycles[256];
+    uint64_t pc_count[0x10000];
+    uint64_t pc_cycles[0x10000];
+    uint32_t pc_instruction[0x10000]; // last instruction word seen at each PC
+
+public:
+    Profiler();
+
+    void record(uint16_t pc, uint32_t instruction, uint64_t cycles) {
+        uint8_t opcode = (instruction >> 16) & 0xFF;
+        if (opcode == 0xCB) {
+            uint8_t cb_opcode = (instruction >> 8) & 0xFF;
+            cb_count[cb_opcode]++;
+            cb_cycles[cb_opcode] += cycles;
+        } else {
+            opcode_count[opcode]++;
+            opcode_cycles[opcode] += cycles;
+        }
+        pc_count[pc]++;
+        pc_cycles[pc] += cycles;
+        pc_instruction[pc] = instruction;
+    }
+
+    // Every executed opcode and the top_pcs busiest addresses, each sorted
+    // by emulated cycles. cpu supplies the handler names.
+    void report(std::ostream &out, CPU &cpu, size_t top_pcs = 50) const;
+};
+
+#endif // ENABLE_PROFILER
@@ -0,0 +1,61 @@
+#pragma once
+#include <stdint.h>
+
+class CPU;
+
+// Everything that happens at a known emulated time. There is at most one
+// pending event of each type.
+enum EventType : uint8_t {
+    EVENT_PPU,   // end of the current PPU mode
+    EVENT_TIMER, // TIMA overflow
+    EVENT_DMA,   // OAM DMA completion
+    EVENT_FRAME, // end of a host frame: input polling and frame pacing
+    EVENT_COUNT
+};
+
+struct Event {
+    uint64_t time; // M-cycles
+    EventType type;
+};
+
+/**
+ * Cycle-timestamped event queue. The CPU runs uninterrupted up to the
+ * next event, then the main loop services whatever is due.
+ *
+ * With only a handful of event types the queue is a small array kept
+ * sorted by time. Scheduling an event earlier than the end of the CPU's
+ * current run() slice shortens that slice.
+ */
+class Scheduler {
+private:
+    Event events[EVENT_COUNT]; // pending events, soonest first
+    uint8_t count;
+    CPU *cpu; // the clock, and the run() slice to shorten
+
+    void remove(EventType type);
+
+public:
+    Scheduler();
+
+    void connect_cpu(CPU *cpu);
+
+    // Current emulated time in M-cycles
+    uint64_t now() const;
+
+    // Set the time of an event, replacing its pending one if any
+    void schedule(EventType type, uint64_t time);
+    void cancel(EventType type);
+
+    // Time of the soonest pending event (UINT64_MAX if none)
+    uint64_t next_time() const { return count ? events[0].time : UINT64_MAX; }
+
+    // Take the soonest event if it is due at time now
+    bool pop_due(uint64_t now, Event &event);
+
+    // End the CPU's run() slice after the current instruction, so that an
+    // interrupt that may have become pending is taken right away
+    void end_slice();
+
+    // Same pending events, for differential checking
+    bool same_events(const Scheduler &other) const;
+};
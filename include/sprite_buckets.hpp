@@ -0,0 +1,44 @@
+#pragma once
+#include <stdint.h>
+
+/**
+ * The sprites on each visible line, as OAM indices already in drawing
+ * priority order (lower X first, then lower OAM index), at most 10 per line
+ * like the hardware's OAM scan. The buckets are rebuilt from OAM only when
+ * the bus reports an OAM write or DMA, or when the sprite height (LCDC bit
+ * 2) changes, instead of rescanning all 40 entries on every line.
+ */
+class SpriteBuckets {
+public:
+    static const int LINES = 144;
+    static const int MAX_PER_LINE = 10;
+
+private:
+    uint8_t sprites[LINES][MAX_PER_LINE];
+    uint8_t counts[LINES];
+    const uint8_t *oam; // 0xFE00 - 0xFE9F
+    bool dirty;
+    bool built_tall; // sprite height the buckets were built for
+
+    void rebuild(bool tall);
+
+public:
+    uint64_t rebuilds;
+
+    SpriteBuckets();
+
+    void connect_oam(const uint8_t *oam) { this->oam = oam; }
+
+    // Called by the bus on OAM writes and DMA transfers
+    void invalidate() { dirty = true; }
+
+    // OAM indices of the sprites on row (0-143) for 8x8 or 8x16 sprites;
+    // sets count to how many there are
+    const uint8_t *line(uint8_t row, bool tall, int &count) {
+        if (dirty || tall != built_tall) {
+            rebuild(tall);
+        }
+        count = counts[row];
+        return sprites[row];
+    }
+};
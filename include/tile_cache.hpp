@@ -0,0 +1,50 @@
+#pragma once
+#include <stdint.h>
+#include "pixel_kernels.hpp"
+
+/**
+ * The 384 tiles of tile data (0x8000 - 0x97FF), decoded from 2bpp bitplanes
+ * into one color index (0-3) per pixel, so the PPU renders a tile row with
+ * palette lookups. Tiles are decoded lazily: the bus marks a tile dirty when
+ * the CPU writes one of its 16 bytes, and the next row() call decodes it
+ * again. Everything starts dirty.
+ */
+class TileCache {
+public:
+    static const int TILE_COUNT = 384;
+    static const uint16_t TILE_DATA_START = 0x8000;
+    static const uint16_t TILE_DATA_END = 0x9800; // tile maps from here on
+
+private:
+    uint8_t pixels[TILE_COUNT][8][8]; // [tile][row][column], leftmost pixel first
+    uint64_t dirty[TILE_COUNT / 64];  // one bit per tile
+    const uint8_t *vram;              // 0x8000 - 0x9FFF
+    const PixelKernels *kernels;
+
+    void decode(int tile);
+
+public:
+    uint64_t tiles_decoded;
+
+    TileCache();
+
+    void connect_vram(const uint8_t *vram) { this->vram = vram; }
+
+    static bool is_tile_data(uint16_t addr) {
+        return static_cast<uint16_t>(addr - TILE_DATA_START) < TILE_DATA_END - TILE_DATA_START;
+    }
+    // Called by the bus on writes to tile data: mark the tile holding addr
+    void invalidate(uint16_t addr) {
+        int tile = (addr - TILE_DATA_START) >> 4;
+        dirty[tile >> 6] |= uint64_t(1) << (tile & 63);
+    }
+    void invalidate_all();
+
+    // Color indices of one row (0-7) of a tile (0-383, 0x8000 + 16 * tile)
+    const uint8_t *row(int tile, int y) {
+        if (dirty[tile >> 6] & (uint64_t(1) << (tile & 63))) {
+            decode(tile);
+        }
+        return pixels[tile][y];
+    }
+};
@@ -1,18 +1,43 @@
 #pragma once
-#include "mmu.hpp"
-#include "RAM.hpp"
+#include <stdint.h>
+#include "InterruptHandler.hpp"
+#include "scheduler.hpp"
 
+/**
+ * DIV, TIMA, TMA and TAC. Nothing is ticked: DIV is worked out from the
+ * cycle counter when read, TIMA is brought up to date when accessed, and
+ * its overflow is a scheduler event.
+ */
 class Timer {
 private:
-	const int DIVIDER_REG = 0xFF04;
-	const int TIMA_REG = 0xFF05;
-	const int TMA_REG = 0xFF06;
-	const int TAC_REG = 0xFF07;
-	MMU* mmu;
-	RAM* ram;
+	static const int DIVIDER_REG = 0xFF04;
+	static const int TIMA_REG = 0xFF05;
+	static const int TMA_REG = 0xFF06;
+	static const int TAC_REG = 0xFF07;
+	InterruptHandler* IH;
+	Scheduler* scheduler;
+
+	uint64_t div_start; // M-cycle of the last DIV reset
+	uint8_t tima;
+	uint64_t tima_time; // M-cycle tima was last brought up to date
+	uint8_t tma;
+	uint8_t tac;
+
+	uint64_t tima_period() const;
+	void sync_tima(uint64_t now);
+	void schedule_overflow();
 public:
 	Timer();
-	void connect_mmu(MMU* mmu);
-	void connect_ram(RAM* ram);
-	void tick(uint64_t outsideClock);
-};
\ No newline at end of file
+	void connect_interrupt_handler(InterruptHandler* IH);
+	void connect_scheduler(Scheduler* scheduler);
+
+	// 0xFF04 - 0xFF07, routed here by the bus
+	uint8_t read_register(uint16_t addr);
+	void write_register(uint16_t addr, uint8_t data);
+
+	// EVENT_TIMER: TIMA overflowed at time
+	void handle_event(uint64_t time);
+
+	// Same registers and timestamps, for differential checking
+	bool same_state(const Timer &other) const;
+};
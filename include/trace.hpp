@@ -0,0 +1,135 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// One executed instruction in a binary trace file. The CPU state is taken
+// before the instruction runs; the writes are the bus writes it made.
+struct TraceRecord {
+    uint64_t cycles;      // M-cycle count before the instruction
+    uint16_t pc;
+    uint16_t sp;
+    uint16_t af;
+    uint16_t bc;
+    uint16_t de;
+    uint16_t hl;
+    uint8_t bytes[3];     // instruction bytes as fetched (see CPU::get_instruction_length)
+    uint8_t state;        // TRACE_IME | TRACE_HALTED
+    uint16_t write_addr[2];
+    uint8_t write_data[2];
+    uint8_t write_count;  // writes made; only the first two are recorded
+    uint8_t reserved;
+};
+static_assert(sizeof(TraceRecord) == 32, "trace records are 32 bytes on disk");
+
+const uint8_t TRACE_IME = 1 << 0;
+const uint8_t TRACE_HALTED = 1 << 1;
+
+// A trace file is this header followed by TraceRecords in host byte order
+struct TraceHeader {
+    char magic[8];        // TRACE_MAGIC
+    uint32_t version;     // TRACE_VERSION
+    uint32_t record_size; // sizeof(TraceRecord)
+};
+const char TRACE_MAGIC[8] = {'G', 'B', 'T', 'R', 'A', 'C', 'E', 0};
+const uint32_t TRACE_VERSION = 2;
+
+#ifdef ENABLE_TRACE
+
+#include <stdio.h>
+#include <atomic>
+#include <string>
+#include <thread>
+
+/**
+ * Binary execution trace (build with ENABLE_TRACE).
+ *
+ * The CPU fills one TraceRecord per instruction in a fixed-size ring
+ * buffer, and a background thread streams filled records to the trace
+ * file. The ring has a single producer (the emulation thread) and a single
+ * consumer (the writer), so it needs no locks: each side owns one index
+ * and publishes it with release/acquire atomics. When the writer falls a
+ * whole ring behind, the CPU waits for it rather than dropping records.
+ *
+ * Only instructions are traced. Interrupt dispatch, DMA and cycles skipped
+ * by HALT or idle-loop fast-forwarding show up as jumps in the cycle count.
+ */
+class Tracer {
+private:
+    static const uint64_t CAPACITY = 1 << 16; // records (2MB)
+
+    TraceRecord *ring;
+    alignas(64) std::atomic<uint64_t> head; // next record the CPU fills
+    alignas(64) std::atomic<uint64_t> tail; // next record the writer saves
+    alignas(64) uint64_t cached_tail;       // producer's last view of tail
+    TraceRecord *current;                   // record of the instruction in flight
+
+    FILE *file;
+    std::thread writer;
+    std::atomic<bool> running;
+    void write_loop();
+
+public:
+    uint64_t records; // instructions traced
+    uint64_t stalls;  // times the CPU waited for the writer
+
+    Tracer();
+    ~Tracer();
+
+    // Start streaming to path. Returns false if it can't be written.
+    bool start(const std::string &path);
+    // Save everything recorded so far and close the file
+    void stop();
+
+    // Called by the CPU around each instruction, and by the bus for each
+    // write in between
+    void begin(uint64_t cycles, uint16_t pc, uint16_t sp, uint16_t af, uint16_t bc, uint16_t de, uint16_t hl,
+               uint32_t instruction, bool ime, bool halted) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        while (h - cached_tail >= CAPACITY) {
+            cached_tail = tail.load(std::memory_order_acquire);
+            if (h - cached_tail >= CAPACITY) {
+                stalls++;
+                std::this_thread::yield();
+            }
+        }
+        TraceRecord *r = &ring[h & (CAPACITY - 1)];
+        r->cycles = cycles;
+        r->pc = pc;
+        r->sp = sp;
+        r->af = af;
+        r->bc = bc;
+        r->de = de;
+        r->hl = hl;
+        r->bytes[0] = static_cast<uint8_t>(instruction >> 16);
+        r->bytes[1] = static_cast<uint8_t>(instruction >> 8);
+        r->bytes[2] = static_cast<uint8_t>(instruction);
+        r->state = (ime ? TRACE_IME : 0) | (halted ? TRACE_HALTED : 0);
+        r->write_count = 0;
+        r->reserved = 0;
+        current = r;
+    }
+    void note_write(uint16_t addr, uint8_t data) {
+        if (current) {
+            if (current->write_count < 2) {
+                current->write_addr[current->write_count] = addr;
+                current->write_data[current->write_count] = data;
+            }
+            if (current->write_count < 0xFF) {
+                current->write_count++;
+            }
+        }
+    }
+    void end() {
+        if (current) {
+            for (uint8_t i = current->write_count; i < 2; i++) {
+                current->write_addr[i] = 0;
+                current->write_data[i] = 0;
+            }
+            current = nullptr;
+            head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+            records++;
+        }
+    }
+};
+
+#endif // ENABLE_TRACE
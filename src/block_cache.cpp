@@ -0,0 +1,114 @@
+#include "../include/block_cache.hpp"
+#include "../include/bus.hpp"
+#include <algorithm>
+
+BlockCache::BlockCache() {
+    for (int i = 0; i < 256; i++) {
+        blocks[i] = nullptr;
+    }
+    generation = 0;
+    bus = nullptr;
+    blocks_decoded = 0;
+    blocks_invalidated = 0;
+}
+
+BlockCache::~BlockCache() {
+    for (int page = 0; page < 256; page++) {
+        if (!blocks[page]) {
+            continue;
+        }
+        for (int i = 0; i < 256; i++) {
+            delete blocks[page][i];
+        }
+        delete[] blocks[page];
+    }
+    for (BasicBlock *block : retired) {
+        delete block;
+    }
+}
+
+void BlockCache::connect_bus(Bus *bus) {
+    this->bus = bus;
+}
+
+void BlockCache::add_to_page(uint8_t page, BasicBlock *block) {
+    page_blocks[page].push_back(block);
+    if (bus && page_blocks[page].size() == 1) {
+        bus->set_page_watched(page, true);
+    }
+}
+
+void BlockCache::remove_from_page(uint8_t page, BasicBlock *block) {
+    std::vector<BasicBlock *> &list = page_blocks[page];
+    list.erase(std::remove(list.begin(), list.end(), block), list.end());
+    if (bus && list.empty()) {
+        bus->set_page_watched(page, false);
+    }
+}
+
+BasicBlock *BlockCache::lookup(uint16_t pc) {
+    // Nothing can be stepping through a retired block between lookups
+    if (!retired.empty()) {
+        for (BasicBlock *block : retired) {
+            delete block;
+        }
+        retired.clear();
+    }
+
+    BasicBlock **page = blocks[pc >> 8];
+    return page ? page[pc & 0xFF] : nullptr;
+}
+
+BasicBlock *BlockCache::insert(BasicBlock *block) {
+    uint8_t first_page = block->start_pc >> 8;
+    uint8_t last_page = (block->end_pc - 1) >> 8;
+
+    if (!blocks[first_page]) {
+        blocks[first_page] = new BasicBlock *[256]();
+    }
+    blocks[first_page][block->start_pc & 0xFF] = block;
+
+    add_to_page(first_page, block);
+    if (last_page != first_page) {
+        add_to_page(last_page, block);
+    }
+
+    blocks_decoded++;
+    return block;
+}
+
+void BlockCache::retire_block(BasicBlock *block) {
+    uint8_t first_page = block->start_pc >> 8;
+    uint8_t last_page = (block->end_pc - 1) >> 8;
+
+    blocks[first_page][block->start_pc & 0xFF] = nullptr;
+
+    remove_from_page(first_page, block);
+    if (last_page != first_page) {
+        remove_from_page(last_page, block);
+    }
+
+    retired.push_back(block);
+    blocks_invalidated++;
+}
+
+void BlockCache::invalidate(uint16_t addr) {
+    std::vector<BasicBlock *> &candidates = page_blocks[addr >> 8];
+    bool invalidated = false;
+
+    // Retiring a block removes it from this list, so only advance on a miss
+    size_t i = 0;
+    while (i < candidates.size()) {
+        BasicBlock *block = candidates[i];
+        if (addr >= block->start_pc && addr < block->end_pc) {
+            retire_block(block);
+            invalidated = true;
+        } else {
+            i++;
+        }
+    }
+
+    if (invalidated) {
+        generation++;
+    }
+}
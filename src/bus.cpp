@@ -0,0 +1,458 @@
+#include "../include/bus.hpp"
+#include "../include/InterruptHandler.hpp"
+#include "../include/scheduler.hpp"
+#include "../include/timer.hpp"
+#include <string.h>
+
+Bus::Bus() {
+    // Cartridge ROM is loaded separately, everything else starts cleared
+    memset(mem, 0, sizeof(mem));
+
+    // I/O Registers : 0xFF00 - 0xFF7F
+    // Post-boot register values
+    mem[0xFF05] = 0x00; // TIMA
+    mem[0xFF06] = 0x00; // TMA
+    mem[0xFF07] = 0x00; // TAC
+    mem[0xFF10] = 0x80; // NR10
+    mem[0xFF11] = 0xBF; // NR11
+    mem[0xFF12] = 0xF3; // NR12
+    mem[0xFF14] = 0xBF; // NR14
+    mem[0xFF16] = 0x3F; // NR21
+    mem[0xFF17] = 0x00; // NR22
+    mem[0xFF19] = 0xBF; // NR24
+    mem[0xFF1A] = 0x7F; // NR30
+    mem[0xFF1B] = 0xFF; // NR31
+    mem[0xFF1C] = 0x9F; // NR32
+    mem[0xFF1E] = 0xBF; // NR33
+    mem[0xFF20] = 0xFF; // NR41
+    mem[0xFF21] = 0x00; // NR42
+    mem[0xFF22] = 0x00; // NR43
+    mem[0xFF23] = 0xBF; // NR30
+    mem[0xFF24] = 0x77; // NR50
+    mem[0xFF25] = 0xF3; // NR51
+    mem[0xFF26] = 0xF1; // NR52
+    mem[0xFF40] = 0x91; // LCDC
+    mem[0xFF42] = 0x00; // SCY
+    mem[0xFF43] = 0x00; // SCX
+    mem[0xFF45] = 0x00; // LYC
+    mem[0xFF47] = 0xFC; // BGP
+    mem[0xFF48] = 0xFF; // OBP0
+    mem[0xFF49] = 0xFF; // OBP1
+    mem[0xFF4A] = 0x00; // WY
+    mem[0xFF4B] = 0x00; // WX
+
+
+    transfer_pending = false;
+    input = nullptr;
+    block_cache = nullptr;
+    tile_cache = nullptr;
+    sprite_buckets = nullptr;
+    timer = nullptr;
+    scheduler = nullptr;
+    IH = nullptr;
+#ifdef ENABLE_TRACE
+    tracer = nullptr;
+#endif
+    build_page_tables();
+}
+
+void Bus::connect_input(Input *input) {
+    this->input = input; 
+}
+
+void Bus::connect_block_cache(BlockCache *block_cache) {
+    this->block_cache = block_cache;
+    block_cache->connect_bus(this);
+}
+
+void Bus::connect_tile_cache(TileCache *tile_cache) {
+    this->tile_cache = tile_cache;
+}
+
+void Bus::connect_sprite_buckets(SpriteBuckets *sprite_buckets) {
+    this->sprite_buckets = sprite_buckets;
+}
+
+void Bus::connect_timer(Timer *timer) {
+    this->timer = timer;
+}
+
+void Bus::connect_scheduler(Scheduler *scheduler) {
+    this->scheduler = scheduler;
+}
+
+void Bus::connect_interrupt_handler(InterruptHandler *IH) {
+    this->IH = IH;
+}
+
+// Plain memory on both sides: ROM (no MBC yet), VRAM and WRAM for reads,
+// VRAM and WRAM for writes. ROM writes are MBC control and go to the slow
+// path, as do external RAM, echo RAM, OAM and I/O. Page 0xFF has no entry:
+// read_mem / write_mem check for its HRAM part before the slow path.
+void Bus::build_page_tables() {
+    for (int page = 0; page < 256; page++) {
+        bool direct_read = page <= 0x9F || (page >= 0xC0 && page <= 0xDF);
+        read_pages[page] = direct_read ? &mem[page << 8] : nullptr;
+        write_pages[page] = direct_write_page(page);
+    }
+}
+
+uint8_t *Bus::direct_write_page(uint8_t page) {
+    bool direct_write = (page >= 0x80 && page <= 0x9F) || (page >= 0xC0 && page <= 0xDF);
+    if (!direct_write || (block_cache && block_cache->is_code(page << 8))) {
+        return nullptr;
+    }
+    return &mem[page << 8];
+}
+
+void Bus::set_page_watched(uint8_t page, bool watched) {
+    write_pages[page] = watched ? nullptr : direct_write_page(page);
+}
+
+uint8_t Bus::read_mem_slow(uint16_t addr) {
+    // HRAM : 0xFF80 - 0xFFFE (read_mem / write_mem handle it inline)
+    if (addr >= 0xFF80 && addr <= 0xFFFE) {
+        return read_raw(addr);
+    }
+
+    // ROM Bank 0 : 0x0000 - 0x3FFF
+    if (addr <= 0x3FFF) {
+        return read_raw(addr);
+    }
+
+    // Switchable ROM : 0x4000 - 0x7FFF
+    if (addr >= 0x4000 && addr <= 0x7FFF) {
+        return read_raw(addr);
+    }
+
+    // VRAM : 0x8000 - 0x9FFF
+    if (addr >= 0x8000 && addr <= 0x9FFF) {
+        return read_raw(addr);
+    }
+
+    // External RAM : 0xA000 - 0xBFFF
+    if (addr >= 0xA000 && addr <= 0xBFFF) {
+        return 0xFF; // Tetris cartridge does not contain external RAM chip
+    }
+
+    // WRAM : 0xC000 - 0xDFFF
+    if (addr >= 0xC000 && addr <= 0xDFFF) {
+        return read_raw(addr);
+    }
+
+    // Echo RAM (unusable) : 0xE000 - 0xFDFF
+    if (addr >= 0xE000 && addr <= 0xFDFF) {
+        return read_raw(addr - 0x2000);
+    }
+
+    // OAM : 0xFE00 - 0xFE9F
+    if (addr >= 0xFE00 && addr <= 0xFE9F) {
+        uint8_t stat = read_raw(0xFF41);
+
+        if ((stat & 0b00000011) == 0b00000010 || (stat & 0b00000011) == 0b00000011) { // Mode 2 or Mode 3
+            return 0xFF;
+        } else {
+            return read_raw(addr);
+        }
+    }
+
+    // Unusable : 0xFEA0 - 0xFEFF
+    if (addr >= 0xFEA0 && addr <= 0xFEFF) {
+        return 0xFF;
+    }
+
+    // I/O Registers : 0xFF00 - 0xFF7F
+    if (addr >= 0xFF00 && addr <= 0xFF7F) {
+        switch (addr) {
+            case 0xFF00: { // JOYP - Joypad Input Register
+                return input->get_joyp_state(read_raw(addr));
+            }
+
+            case 0xFF04:   // DIV - Divider Register (Timer)
+            case 0xFF05:   // TIMA - Timer Counter
+            case 0xFF06:   // TMA - Timer Modulo
+            case 0xFF07: { // TAC - Timer Control
+                return timer ? timer->read_register(addr) : read_raw(addr);
+            }
+
+            case 0xFF0F: { // IF - Interrupt Flag
+                return IH ? IH->get_IF() : read_raw(addr) | 0xE0; // Top 3 bits always read as 1
+            }
+
+            case 0xFF40: { // LCDC - LCD Control
+                return read_raw(addr);
+            }
+            
+            case 0xFF41: { // STAT - LCD Status
+                return read_raw(addr);
+            }
+
+            case 0xFF42: { // SCY - Scroll Y
+                return read_raw(addr);
+            }
+
+            case 0xFF43: { // SCX - Scroll X
+                return read_raw(addr);
+            }
+
+            case 0xFF44: { // LY - LCD Y-Coordinate (Read-Only, updated by PPU)
+                return read_raw(addr);
+            }
+
+            case 0xFF45: { // LYC - LY Compare
+                return read_raw(addr);
+            }
+
+            case 0xFF46: { // DMA - DMA Transfer Start Address
+                return read_raw(addr);
+            }
+
+            case 0xFF47: { // BGP - Background Palette Data
+                return read_raw(addr);
+            }
+
+            case 0xFF48: { // OBP0 - Object Palette 0 Data
+                return read_raw(addr);
+            }
+
+            case 0xFF49: { // OBP1 - Object Palette 1 Data
+                return read_raw(addr);
+            }
+
+            case 0xFF4A: { // WY - Window Y Position
+                return read_raw(addr);
+            }
+            
+            case 0xFF4B: { // WX - Window X Position minus 7
+                return read_raw(addr);
+            }
+
+            default: {
+                return read_raw(addr);
+            }
+        }
+    }
+
+    // IE Register : 0xFFFF
+    if (addr == 0xFFFF) {
+        return IH ? IH->get_IE() : read_raw(addr);
+    }
+
+    // Invalid address range
+    std::cerr << "Bus Warning: Read from invalid address: 0x" << std::hex << addr << std::endl;
+    return 0xFF;
+}
+
+void Bus::write_mem_slow(uint16_t addr, uint8_t data) {
+    // HRAM : 0xFF80 - 0xFFFE (read_mem / write_mem handle it inline)
+    if (addr >= 0xFF80 && addr <= 0xFFFE) {
+        write_raw(addr, data);
+        invalidate_code(addr);
+        return;
+    }
+
+    // ROM Bank 0 : 0x0000 - 0x3FFF
+    if (addr <= 0x3FFF) {
+        return;
+    }
+
+    // Switchable ROM : 0x4000 - 0x7FFF
+    if (addr >= 0x4000 && addr <= 0x7FFF) {
+        return; // Tetris does not use MBC
+    }
+
+    // VRAM : 0x8000 - 0x9FFF
+    if (addr >= 0x8000 && addr <= 0x9FFF) {
+        write_raw(addr, data);
+        invalidate_code(addr);
+        invalidate_tile(addr);
+        return;
+    }
+
+    // External RAM : 0xA000 - 0xBFFF
+    if (addr >= 0xA000 && addr <= 0xBFFF) {
+        return; // Tetris cartridge does not contain external RAM chip
+    }
+
+    // WRAM : 0xC000 - 0xDFFF
+    if (addr >= 0xC000 && addr <= 0xDFFF) {
+        write_raw(addr, data);
+        invalidate_code(addr);
+        return;
+    }
+
+    // Echo RAM (unusable) : 0xE000 - 0xFDFF
+    if (addr >= 0xE000 && addr <= 0xFDFF) {
+        write_raw(addr - 0x2000, data);
+        invalidate_code(addr - 0x2000);
+        return;
+    }
+
+    // OAM : 0xFE00 - 0xFE9F
+    if (addr >= 0xFE00 && addr <= 0xFE9F) {
+        uint8_t stat = read_raw(0xFF41);
+
+        if ((stat & 0b00000011) == 0b00000011) { // Mode 3
+            return;
+        } else {
+            write_raw(addr, data);
+            if (sprite_buckets) {
+                sprite_buckets->invalidate();
+            }
+            return;
+        }
+    }
+
+    // Unusable : 0xFEA0 - 0xFEFF
+    if (addr >= 0xFEA0 && addr <= 0xFEFF) {
+        return;
+    }
+
+    // I/O Registers : 0xFF00 - 0xFF7F
+    if (addr >= 0xFF00 && addr <= 0xFF7F) {
+        switch (addr) {
+            case 0xFF00: { // JOYP - Joypad Input Register
+                write_raw(addr, (read_raw(addr) & 0xCF) | (data & 0x30));
+                return;
+            }
+
+            case 0xFF04:   // DIV - Divider Register (Timer)
+            case 0xFF05:   // TIMA - Timer Counter
+            case 0xFF06:   // TMA - Timer Modulo
+            case 0xFF07: { // TAC - Timer Control
+                if (timer) {
+                    timer->write_register(addr, data);
+                } else {
+                    write_raw(addr, addr == 0xFF04 ? 0 : data); // Any write resets DIV to 0
+                }
+                return;
+            }
+
+            case 0xFF0F: { // IF - Interrupt Flag
+                if (IH) {
+                    IH->set_IF(data);
+                } else {
+                    write_raw(addr, data); // Restriction on top 3 bits read-enforced
+                }
+                if (scheduler) {
+                    scheduler->end_slice(); // may have made an interrupt pending
+                }
+                return;
+            }
+
+            case 0xFF40: { // LCDC - LCD Control
+                write_raw(addr, data);
+                return;
+            }
+            
+            case 0xFF41: { // STAT - LCD Status
+                write_raw(addr, (read_raw(addr) & 0x87) | (data & 0x78)); // Combine R/O and W bits
+                return;
+            }
+
+            case 0xFF42: { // SCY - Scroll Y
+                write_raw(addr, data);
+                return;
+            }
+
+            case 0xFF43: { // SCX - Scroll X
+                write_raw(addr, data);
+                return;
+            }
+
+            case 0xFF44: { // LY - LCD Y-Coordinate (Read-Only, updated by PPU)
+                return;
+            }
+
+            case 0xFF45: { // LYC - LY Compare
+                write_raw(addr, data);
+                return;
+            }
+
+            case 0xFF46: { // DMA - DMA Transfer Start Address
+                write_raw(addr, data);
+                fill_buffer(static_cast<uint16_t>(data) << 8);
+                transfer_pending = true;
+                if (scheduler) {
+                    scheduler->schedule(EVENT_DMA, scheduler->now() + DMA_CYCLES);
+                } else {
+                    dma_transfer();
+                }
+                return;
+            }
+
+            case 0xFF47: { // BGP - Background Palette Data
+                write_raw(addr, data);    
+                return;
+            }
+
+            case 0xFF48: { // OBP0 - Object Palette 0 Data
+                write_raw(addr, data);    
+                return;
+            }
+
+            case 0xFF49: { // OBP1 - Object Palette 1 Data
+                write_raw(addr, data);
+                return;
+            }
+
+            case 0xFF4A: { // WY - Window Y Position
+                uint8_t stat = read_raw(0xFF41);
+
+                if ((stat & 0b00000011) == 0b00000011) { // Mode 3
+                    return;
+                } else {
+                    write_raw(addr, data);
+                    return;
+                }
+            }
+            
+            case 0xFF4B: { // WX - Window X Position minus 7
+                uint8_t stat = read_raw(0xFF41);
+
+                if ((stat & 0b00000011) == 0b00000011) { // Mode 3
+                    return;
+                } else {
+                    write_raw(addr, data);
+                    return;
+                }
+            }
+
+            default: {
+                write_raw(addr, data);
+                return;
+            }
+        }
+    }
+
+    // IE Register : 0xFFFF
+    if (addr == 0xFFFF) {
+        if (IH) {
+            IH->set_IE(data);
+        } else {
+            write_raw(addr, data);
+        }
+        if (scheduler) {
+            scheduler->end_slice(); // may have made an interrupt pending
+        }
+        return;
+    }
+
+    // Invalid address range
+    std::cerr << "Bus Warning: Write to invalid address: 0x" << std::hex << addr << std::endl;
+    return;
+}
+
+void Bus::fill_buffer(uint16_t addr) {
+    for (int i = 0; i < 160; i++) {
+        dma_buffer[i] = read_raw(addr + i);
+    }
+}
+
+void Bus::dma_transfer() {
+    memcpy(&mem[OAM_START], dma_buffer, OAM_SIZE);
+    if (sprite_buckets) {
+        sprite_buckets->invalidate();
+    }
+    transfer_pending = false;
+}
@@ -1,4 +1,5 @@
 #include "../include/cpu.hpp"
+#include "../include/alu_tables.hpp"
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -7,6 +8,7 @@
 
 CPU::CPU() {
     cycles = 0;
+    run_target = 0;
     
     pc = 0x0100;
     sp = 0xFFFE;
@@ -14,15 +16,41 @@ CPU::CPU() {
     ime = true;
     halted = false;
 
+    block_cache = nullptr;
+    block_op = nullptr;
+    block_end = nullptr;
+    block_generation = 0;
+    idle_block = nullptr;
+    idle_generation = 0;
+    idle_entry_cycles = 0;
+    skip_idle_loops = true;
+    idle_cycles_skipped = 0;
+#ifdef ENABLE_JIT
+    jit = nullptr;
+    block_native = nullptr;
+    block_start = nullptr;
+#endif
+#ifdef ENABLE_PROFILER
+    profiler = nullptr;
+#endif
+#ifdef ENABLE_TRACE
+    tracer = nullptr;
+#endif
+
     // Register initialization
     regs[A_REGISTER] = 0x01;
     regs[FLAGS_REGISTER] = 0xB0; // Flag initialization
+    unpack_flags();
     regs[B_REGISTER] = 0x00;
     regs[C_REGISTER] = 0x13;
     regs[D_REGISTER] = 0x00;
     regs[E_REGISTER] = 0xD8;
     regs[H_REGISTER] = 0x01;
     regs[L_REGISTER] = 0x4D;
+
+    if (!dispatch_tables_built) {
+        build_dispatch_tables();
+    }
 }
 
 uint16_t CPU::get_pc() {
@@ -36,9 +64,9 @@ uint16_t CPU::get_sp() {
 uint32_t CPU::fetch_instruction() {
     // get the next three bytes from memory using PC
 	uint32_t instruction = 0;
-    uint32_t firstByte = static_cast<uint32_t>(mmu->read_mem(pc)) << 16;
-    uint32_t secondByte = static_cast<uint32_t>(mmu->read_mem(pc+1)) << 8;
-    uint32_t thirdByte = static_cast<uint32_t>(mmu->read_mem(pc+2));
+    uint32_t firstByte = static_cast<uint32_t>(bus->read_mem(pc)) << 16;
+    uint32_t secondByte = static_cast<uint32_t>(bus->read_mem(pc+1)) << 8;
+    uint32_t thirdByte = static_cast<uint32_t>(bus->read_mem(pc+2));
     //std::cout << std::bitset<32>(firstByte) << ", " << std::bitset<32>(secondByte) << ", " << std::bitset<32>(thirdByte) << "\n";
     instruction |= firstByte;
     instruction |= secondByte;
@@ -49,112 +77,796 @@ uint32_t CPU::fetch_instruction() {
 	return instruction;
 }
 
-void CPU::connect_mmu(MMU *mmu) {
-    this->mmu = mmu;
+void CPU::connect_bus(Bus *bus) {
+    this->bus = bus;
+}
+
+void CPU::connect_block_cache(BlockCache *block_cache) {
+    this->block_cache = block_cache;
+    block_op = nullptr;
+    block_end = nullptr;
+}
+
+#ifdef ENABLE_JIT
+void CPU::connect_jit(Jit *jit) {
+#if defined(ENABLE_PROFILER) || defined(ENABLE_TRACE)
+    // Native blocks would run past the profiler's counters and the tracer
+    (void)jit;
+#else
+    this->jit = jit;
+#endif
+}
+#endif
+
+#ifdef ENABLE_PROFILER
+void CPU::connect_profiler(Profiler *profiler) {
+    this->profiler = profiler;
+}
+
+// Attribute the cycles of the instruction in flight to its opcode and PC
+#define PROFILE_BEGIN()                                 \
+    uint16_t profile_pc = pc;                           \
+    uint64_t profile_cycles = cycles
+#define PROFILE_END()                                   \
+    if (profiler) {                                     \
+        profiler->record(profile_pc, instruction, cycles - profile_cycles); \
+    }
+#else
+#define PROFILE_BEGIN()
+#define PROFILE_END()
+#endif
+
+#ifdef ENABLE_TRACE
+void CPU::connect_tracer(Tracer *tracer) {
+    this->tracer = tracer;
 }
 
+// Record the state before the instruction in flight; the bus adds its writes
+#define TRACE_BEGIN()                                   \
+    if (tracer) {                                       \
+        tracer->begin(cycles, pc, sp, get_af(), get_bc(), get_de(), get_hl(), \
+                      instruction, ime, halted);        \
+    }
+#define TRACE_END()                                     \
+    if (tracer) {                                       \
+        tracer->end();                                  \
+    }
+#else
+#define TRACE_BEGIN()
+#define TRACE_END()
+#endif
+
+// One instruction from run(), traced and profiled in those builds
+#define EXECUTE_HANDLER(mnemonic, number)               \
+    {                                                   \
+        TRACE_BEGIN();                                  \
+        PROFILE_BEGIN();                                \
+        execute_##mnemonic##_##number(instruction);     \
+        PROFILE_END();                                  \
+        TRACE_END();                                    \
+    }
+
 void CPU::connect_interrupt_handler(InterruptHandler* IH) {
 	this->IH = IH;
 }
 
+// Pack the flag pieces into F
+void CPU::materialize_flags() {
+    regs[FLAGS_REGISTER] = (regs[FLAGS_REGISTER] & 0x0F) | ((flag_result == 0) << Z_FLAG_BIT) |
+                           (flag_n << N_FLAG_BIT) | (((flag_half >> 4) & 1) << H_FLAG_BIT) |
+                           (flag_c << C_FLAG_BIT);
+}
+
+// Split F into the flag pieces after it was written as a byte
+void CPU::unpack_flags() {
+    uint8_t f = regs[FLAGS_REGISTER];
+    flag_result = ((f >> Z_FLAG_BIT) & 1) ? 0 : 1;
+    flag_n = (f >> N_FLAG_BIT) & 1;
+    flag_half = ((f >> H_FLAG_BIT) & 1) << 4;
+    flag_c = (f >> C_FLAG_BIT) & 1;
+}
+
 // Helper function to set/clear a specific flag bit
 void CPU::set_flag(int flag_bit, bool value) {
-    if (value) {
-        regs[FLAGS_REGISTER] |= (1 << flag_bit);
-    } else {
-        regs[FLAGS_REGISTER] &= ~(1 << flag_bit);
+    switch (flag_bit) {
+        case Z_FLAG_BIT: flag_result = value ? 0 : 1; break;
+        case N_FLAG_BIT: flag_n = value; break;
+        case H_FLAG_BIT: flag_half = value ? 0x10 : 0; break;
+        case C_FLAG_BIT: flag_c = value; break;
     }
 }
 
 bool CPU::get_flag(int flag_bit) {
-    return (regs[FLAGS_REGISTER] >> flag_bit) & 1;
+    switch (flag_bit) {
+        case Z_FLAG_BIT: return flag_result == 0;
+        case N_FLAG_BIT: return flag_n;
+        case H_FLAG_BIT: return (flag_half >> 4) & 1;
+        case C_FLAG_BIT: return flag_c;
+        default: return false;
+    }
 }
 
-uint16_t CPU::get_hl() {
-    return (static_cast<uint16_t>(regs[H_REGISTER]) << 8) | regs[L_REGISTER];
+uint16_t CPU::get_af() {
+    materialize_flags();
+    return (static_cast<uint16_t>(regs[A_REGISTER]) << 8) | regs[FLAGS_REGISTER];
+}
+
+void CPU::set_af(uint16_t val) {
+    regs[A_REGISTER] = static_cast<uint8_t>((val >> 8) & 0xFF);
+    regs[FLAGS_REGISTER] = static_cast<uint8_t>(val & 0xFF);
+    unpack_flags();
 }
 
-uint16_t CPU::get_bc() {
-    return (static_cast<uint16_t>(regs[B_REGISTER]) << 8) | regs[C_REGISTER];
+void CPU::handle_interrupts() {
+    uint8_t pending = IH->get_pending();
+    if (!pending) {
+        return; // the common case
+    }
+    // HALT ends once an enabled interrupt is requested, even with IME off
+    halted = false;
+    if (!ime) {
+        // not servicing interrupts at this time
+        return;
+    }
+
+    // Service the highest priority one (lowest bit). IME is off in its
+    // handler, so the rest wait for RETI or EI.
+    int bit = 0;
+    while (!(pending & (1 << bit))) {
+        bit++;
+    }
+    bus->push_stack(sp, pc);
+    sp -= 2;
+    cycles += 4;
+    pc = 0x0040 + 8 * bit; // VBLANK, STAT, TIMER, SERIAL, JOYPAD handler address
+    ime = false; // disable interrupts
+    IH->acknowledge(1 << bit);
+}
+
+// DISPATCH
+bool CPU::dispatch_tables_built = false;
+ExecuteHandler CPU::opcode_table[256];
+ExecuteHandler CPU::cb_opcode_table[256];
+uint8_t CPU::opcode_index[256];
+uint8_t CPU::cb_opcode_index[256];
+const char *CPU::opcode_names[256];
+const char *CPU::cb_opcode_names[256];
+
+struct DecodeEntry {
+    bool (CPU::*decode)(uint32_t instruction);
+    ExecuteHandler execute;
+    const char *name;
+};
+
+#define DECODE_ENTRY(mnemonic, number) \
+    { &CPU::decode_##mnemonic##_##number, &CPU::execute_##mnemonic##_##number, #mnemonic " " #number },
+
+static const DecodeEntry decode_entries[HANDLER_COUNT] = {
+    CPU_INSTRUCTION_LIST(DECODE_ENTRY)
+};
+
+#undef DECODE_ENTRY
+
+void CPU::build_dispatch_tables() {
+    // Run every decode predicate once per opcode byte. All predicates only look
+    // at the first byte (and the second byte for 0xCB-prefixed instructions),
+    // except STOP, which is mapped for 0x10 regardless of the padding byte.
+    for (int op = 0; op < 256; op++) {
+        uint32_t instruction = static_cast<uint32_t>(op) << 16;
+        uint32_t cb_instruction = (0xCBu << 16) | (static_cast<uint32_t>(op) << 8);
+
+        opcode_index[op] = HANDLER_COUNT;
+        cb_opcode_index[op] = HANDLER_COUNT;
+        for (int i = 0; i < HANDLER_COUNT; i++) {
+            if (opcode_index[op] == HANDLER_COUNT && (this->*decode_entries[i].decode)(instruction)) {
+                opcode_index[op] = i;
+            }
+            if (cb_opcode_index[op] == HANDLER_COUNT && (this->*decode_entries[i].decode)(cb_instruction)) {
+                cb_opcode_index[op] = i;
+            }
+        }
+
+        bool known = opcode_index[op] != HANDLER_COUNT;
+        opcode_table[op] = known ? decode_entries[opcode_index[op]].execute : nullptr;
+        opcode_names[op] = known ? decode_entries[opcode_index[op]].name : nullptr;
+
+        bool cb_known = cb_opcode_index[op] != HANDLER_COUNT;
+        cb_opcode_table[op] = cb_known ? decode_entries[cb_opcode_index[op]].execute : nullptr;
+        cb_opcode_names[op] = cb_known ? decode_entries[cb_opcode_index[op]].name : nullptr;
+    }
+    dispatch_tables_built = true;
 }
 
-uint16_t CPU::get_de() {
-    return (static_cast<uint16_t>(regs[D_REGISTER]) << 8) | regs[E_REGISTER];
+bool CPU::execute_instruction(uint32_t instruction) {
+    uint8_t opcode = (instruction >> 16) & 0xFF;
+    ExecuteHandler handler = (opcode == 0xCB) ? cb_opcode_table[(instruction >> 8) & 0xFF]
+                                              : opcode_table[opcode];
+    if (!handler) {
+        return false;
+    }
+
+    TRACE_BEGIN();
+    PROFILE_BEGIN();
+    (this->*handler)(instruction);
+    PROFILE_END();
+    TRACE_END();
+    return true;
 }
 
-uint16_t CPU::get_af() {
-    return (static_cast<uint16_t>(regs[A_REGISTER]) << 8) | regs[FLAGS_REGISTER];
+const char *CPU::get_instruction_name(uint32_t instruction) {
+    uint8_t opcode = (instruction >> 16) & 0xFF;
+    const char *name = (opcode == 0xCB) ? cb_opcode_names[(instruction >> 8) & 0xFF]
+                                        : opcode_names[opcode];
+    return name ? name : "UNKNOWN";
+}
+
+// INSTRUCTION TIMING
+// Instruction lengths in bytes (0xCB counts the prefixed opcode byte)
+static const uint8_t instruction_lengths[256] = {
+    1, 3, 1, 1, 1, 1, 2, 1, 3, 1, 1, 1, 1, 1, 2, 1, // 0x00
+    2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1, // 0x10
+    2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1, // 0x20
+    2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1, // 0x30
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x40
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x50
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x60
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x70
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x80
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x90
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0xA0
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0xB0
+    1, 1, 3, 3, 3, 1, 2, 1, 1, 1, 3, 2, 3, 3, 2, 1, // 0xC0
+    1, 1, 3, 1, 3, 1, 2, 1, 1, 1, 3, 1, 3, 1, 2, 1, // 0xD0
+    2, 1, 1, 1, 1, 1, 2, 1, 2, 1, 3, 1, 1, 1, 2, 1, // 0xE0
+    2, 1, 1, 1, 1, 1, 2, 1, 2, 1, 3, 1, 1, 1, 2, 1, // 0xF0
+};
+
+// Base M-cycles, not-taken timing for conditional branches (0 = unused opcode)
+static const uint8_t base_cycles[256] = {
+    1, 3, 2, 2, 1, 1, 2, 1, 5, 2, 2, 2, 1, 1, 2, 1, // 0x00
+    1, 3, 2, 2, 1, 1, 2, 1, 3, 2, 2, 2, 1, 1, 2, 1, // 0x10
+    2, 3, 2, 2, 1, 1, 2, 1, 2, 2, 2, 2, 1, 1, 2, 1, // 0x20
+    2, 3, 2, 2, 3, 3, 3, 1, 2, 2, 2, 2, 1, 1, 2, 1, // 0x30
+    1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1, // 0x40
+    1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1, // 0x50
+    1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1, // 0x60
+    2, 2, 2, 2, 2, 2, 1, 2, 1, 1, 1, 1, 1, 1, 2, 1, // 0x70
+    1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1, // 0x80
+    1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1, // 0x90
+    1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1, // 0xA0
+    1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1, // 0xB0
+    2, 3, 3, 4, 3, 4, 2, 4, 2, 4, 3, 1, 3, 6, 2, 4, // 0xC0
+    2, 3, 3, 0, 3, 4, 2, 4, 2, 4, 3, 0, 3, 0, 2, 4, // 0xD0
+    3, 3, 2, 0, 0, 4, 2, 4, 4, 1, 4, 0, 0, 0, 2, 4, // 0xE0
+    3, 3, 2, 1, 0, 4, 2, 4, 3, 2, 4, 1, 0, 0, 2, 4, // 0xF0
+};
+
+// M-cycles of the 0xCB-prefixed instructions, including the prefix
+static const uint8_t cb_base_cycles[256] = {
+    2, 2, 2, 2, 2, 2, 4, 2, 2, 2, 2, 2, 2, 2, 4, 2, // 0x00
+    2, 2, 2, 2, 2, 2, 4, 2, 2, 2, 2, 2, 2, 2, 4, 2, // 0x10
+    2, 2, 2, 2, 2, 2, 4, 2, 2, 2, 2, 2, 2, 2, 4, 2, // 0x20
+    2, 2, 2, 2, 2, 2, 4, 2, 2, 2, 2, 2, 2, 2, 4, 2, // 0x30
+    2, 2, 2, 2, 2, 2, 3, 2, 2, 2, 2, 2, 2, 2, 3, 2, // 0x40
+    2, 2, 2, 2, 2, 2, 3, 2, 2, 2, 2, 2, 2, 2, 3, 2, // 0x50
+    2, 2, 2, 2, 2, 2, 3, 2, 2, 2, 2, 2, 2, 2, 3, 2, // 0x60
+    2, 2, 2, 2, 2, 2, 3, 2, 2, 2, 2, 2, 2, 2, 3, 2, // 0x70
+    2, 2, 2, 2, 2, 2, 4, 2, 2, 2, 2, 2, 2, 2, 4, 2, // 0x80
+    2, 2, 2, 2, 2, 2, 4, 2, 2, 2, 2, 2, 2, 2, 4, 2, // 0x90
+    2, 2, 2, 2, 2, 2, 4, 2, 2, 2, 2, 2, 2, 2, 4, 2, // 0xA0
+    2, 2, 2, 2, 2, 2, 4, 2, 2, 2, 2, 2, 2, 2, 4, 2, // 0xB0
+    2, 2, 2, 2, 2, 2, 4, 2, 2, 2, 2, 2, 2, 2, 4, 2, // 0xC0
+    2, 2, 2, 2, 2, 2, 4, 2, 2, 2, 2, 2, 2, 2, 4, 2, // 0xD0
+    2, 2, 2, 2, 2, 2, 4, 2, 2, 2, 2, 2, 2, 2, 4, 2, // 0xE0
+    2, 2, 2, 2, 2, 2, 4, 2, 2, 2, 2, 2, 2, 2, 4, 2, // 0xF0
+};
+
+uint8_t CPU::get_instruction_length(uint8_t opcode) {
+    return instruction_lengths[opcode];
 }
 
-void CPU::set_hl(uint16_t val) {
-    regs[H_REGISTER] = static_cast<uint8_t>((val >> 8) & 0xFF);
-    regs[L_REGISTER] = static_cast<uint8_t>(val & 0xFF);
+uint8_t CPU::get_base_cycles(uint32_t instruction) {
+    uint8_t opcode = (instruction >> 16) & 0xFF;
+    return (opcode == 0xCB) ? cb_base_cycles[(instruction >> 8) & 0xFF] : base_cycles[opcode];
+}
+
+// BLOCK CACHE
+// Handlers that can move the PC somewhere other than the next instruction,
+// or change interrupt state, end a block
+static bool ends_block(uint8_t index) {
+    switch (index) {
+        case HANDLER_JP_109: case HANDLER_JP_110: case HANDLER_JP_111:
+        case HANDLER_JR_113: case HANDLER_JR_114:
+        case HANDLER_CALL_116: case HANDLER_CALL_117:
+        case HANDLER_RET_119: case HANDLER_RET_120: case HANDLER_RETI_121:
+        case HANDLER_RST_122:
+        case HANDLER_HALT_123: case HANDLER_STOP_123:
+        case HANDLER_DI_123: case HANDLER_EI_124:
+            return true;
+        default:
+            return false;
+    }
 }
 
-void CPU::set_bc(uint16_t val) {
-    regs[B_REGISTER] = static_cast<uint8_t>((val >> 8) & 0xFF);
-    regs[C_REGISTER] = static_cast<uint8_t>(val & 0xFF);
+// Handler index returned by next_instruction() to enter compiled code
+static const uint8_t NATIVE_BLOCK = HANDLER_COUNT + 1;
+
+// SUPERINSTRUCTIONS
+// Instruction pairs that run() executes with a single dispatch, picked from
+// execution traces of the games: polling loops (LDH A,(n) / AND A / JR NZ),
+// counted loops and the LD A,(HL+) / LD (DE),A copy. The first of each pair
+// only reads memory and never ends a block, so once it is done the second is
+// still cached and at the PC.
+#define CPU_FUSED_LIST(X) \
+    X(LD, 33, AND, 64) X(LD, 33, CP, 59) X(AND, 64, JR, 114) X(OR, 67, JR, 114) \
+    X(CP, 59, JR, 114) X(DEC, 62, JR, 114) X(LD, 20, DEC, 62) X(INC, 60, DEC, 62) \
+    X(LD, 37, LD, 28)
+
+// Dispatch index of each pair, after the handlers and NATIVE_BLOCK
+enum FusedIndex : uint8_t {
+    FUSED_BEFORE_FIRST = NATIVE_BLOCK,
+#define FUSED_INDEX(m1, n1, m2, n2) FUSED_##m1##_##n1##_##m2##_##n2,
+    CPU_FUSED_LIST(FUSED_INDEX)
+#undef FUSED_INDEX
+    FUSED_END
+};
+
+// Fused index for first followed by second, or first if they don't fuse
+static uint8_t fuse_pair(uint8_t first, uint8_t second) {
+#define FUSED_MATCH(m1, n1, m2, n2)                                         \
+    if (first == HANDLER_##m1##_##n1 && second == HANDLER_##m2##_##n2) {    \
+        return FUSED_##m1##_##n1##_##m2##_##n2;                             \
+    }
+    CPU_FUSED_LIST(FUSED_MATCH)
+#undef FUSED_MATCH
+    return first;
 }
 
-void CPU::set_de(uint16_t val) {
-    regs[D_REGISTER] = static_cast<uint8_t>((val >> 8) & 0xFF);
-    regs[E_REGISTER] = static_cast<uint8_t>(val & 0xFF);
+// IDLE LOOPS
+// Registers and flags an instruction reads and writes, as bits: 0-7 follow
+// regs[] (bit 6, F as a whole, is unused) and 8-11 are the Z, N, H and C
+// flags on their own. Only instructions that cannot change memory or
+// control flow are accepted; anything else returns false.
+static const uint16_t IDLE_Z = 1 << 8;
+static const uint16_t IDLE_N = 1 << 9;
+static const uint16_t IDLE_H = 1 << 10;
+static const uint16_t IDLE_C = 1 << 11;
+static const uint16_t IDLE_FLAGS = IDLE_Z | IDLE_N | IDLE_H | IDLE_C;
+
+static uint16_t idle_source(uint8_t r) {
+    // r = 6 is (HL): the address registers are read
+    return (r == 6) ? ((1 << H_REGISTER) | (1 << L_REGISTER)) : (1 << r);
 }
 
-void CPU::set_af(uint16_t val) {
-    regs[A_REGISTER] = static_cast<uint8_t>((val >> 8) & 0xFF);
-    regs[FLAGS_REGISTER] = static_cast<uint8_t>(val & 0xFF);
+// DIV and TIMA change with the cycle counter itself, not at events
+static bool is_timer_counter(uint16_t addr) {
+    return addr == 0xFF04 || addr == 0xFF05;
 }
 
-void CPU::handle_interrupts() {
-	uint8_t IE = IH->get_IE();
-    if (!ime || !IE) {
-        // not servicing interrupts at this time
+static bool idle_loop_effects(uint32_t instruction, uint16_t &reads, uint16_t &writes) {
+    uint8_t opcode = (instruction >> 16) & 0xFF;
+    uint8_t n = (instruction >> 8) & 0xFF;
+    uint16_t nn = n | ((instruction & 0xFF) << 8);
+    reads = 0;
+    writes = 0;
+
+    if (opcode == 0xCB) {
+        if (n < 0x40 || n > 0x7F) {
+            return false;
+        }
+        reads = idle_source(n & 0x07); // BIT b, r: C is left alone
+        writes = IDLE_Z | IDLE_N | IDLE_H;
+        return true;
+    }
+    if (opcode == 0x00) { // NOP
+        return true;
+    }
+    if (opcode == 0xF0 || opcode == 0xFA) { // LDH A, (n) / LD A, (nn)
+        writes = 1 << A_REGISTER;
+        return !is_timer_counter(opcode == 0xF0 ? 0xFF00 | n : nn);
+    }
+    if (opcode == 0xF2) { // LDH A, (C)
+        reads = 1 << C_REGISTER;
+        writes = 1 << A_REGISTER;
+        return true;
+    }
+    if (opcode == 0x0A || opcode == 0x1A) { // LD A, (BC) / LD A, (DE)
+        reads = (opcode == 0x0A) ? ((1 << B_REGISTER) | (1 << C_REGISTER))
+                                 : ((1 << D_REGISTER) | (1 << E_REGISTER));
+        writes = 1 << A_REGISTER;
+        return true;
+    }
+    if (opcode >= 0x40 && opcode <= 0x7F) { // LD r, r' / LD r, (HL)
+        uint8_t dst = (opcode >> 3) & 0x07;
+        if (dst == 6) {
+            return false; // stores, and HALT
+        }
+        reads = idle_source(opcode & 0x07);
+        writes = 1 << dst;
+        return true;
+    }
+    if ((opcode & 0xC7) == 0x06 && opcode != 0x36) { // LD r, n
+        writes = 1 << ((opcode >> 3) & 0x07);
+        return true;
+    }
+    if ((opcode >= 0x80 && opcode <= 0xBF) || (opcode & 0xC7) == 0xC6) { // ALU A, r / ALU A, n
+        uint8_t op = (opcode >> 3) & 0x07; // ADD ADC SUB SBC AND XOR OR CP
+        reads = 1 << A_REGISTER;
+        if (opcode < 0xC0) {
+            reads |= idle_source(opcode & 0x07);
+        }
+        if (op == 1 || op == 3) {
+            reads |= IDLE_C;
+        }
+        writes = IDLE_FLAGS;
+        if (op != 7) {
+            writes |= 1 << A_REGISTER;
+        }
+        return true;
+    }
+    if ((opcode & 0xE7) == 0x20 || (opcode & 0xE7) == 0xC2) { // JR cc / JP cc
+        reads = (opcode & 0x10) ? IDLE_C : IDLE_Z;
+        return true;
+    }
+    return false;
+}
+
+// A block that conditionally branches back to its own start and otherwise
+// only reads memory into registers and flags. If every register it reads is
+// either left untouched by the loop or written earlier in the same pass,
+// each pass ends in the state the previous one did until the memory it
+// polls changes, which only an event can do.
+static bool is_idle_loop(const BasicBlock *block) {
+    const DecodedInstruction &branch = block->instructions.back();
+    uint16_t target;
+    if (branch.handler_index == HANDLER_JR_114) {
+        target = branch.pc + 2 + static_cast<int8_t>((branch.instruction >> 8) & 0xFF);
+    } else if (branch.handler_index == HANDLER_JP_111) {
+        target = ((branch.instruction >> 8) & 0xFF) | ((branch.instruction & 0xFF) << 8);
+    } else {
+        return false;
+    }
+    if (target != block->start_pc) {
+        return false;
+    }
+
+    uint16_t reads[BlockCache::MAX_BLOCK_INSTRUCTIONS];
+    uint16_t writes[BlockCache::MAX_BLOCK_INSTRUCTIONS];
+    uint16_t loop_writes = 0;
+    size_t count = block->instructions.size();
+    for (size_t i = 0; i < count; i++) {
+        if (!idle_loop_effects(block->instructions[i].instruction, reads[i], writes[i])) {
+            return false;
+        }
+        loop_writes |= writes[i];
+    }
+
+    uint16_t written = 0;
+    for (size_t i = 0; i < count; i++) {
+        // A value carried over from the previous pass
+        if (reads[i] & loop_writes & ~written) {
+            return false;
+        }
+        written |= writes[i];
+    }
+
+    // Addresses of indirect reads are checked when skipping, so their
+    // registers must hold the same value on every pass
+    for (size_t i = 0; i < count; i++) {
+        uint8_t opcode = (block->instructions[i].instruction >> 16) & 0xFF;
+        bool indirect = opcode == 0xF2 || opcode == 0x0A || opcode == 0x1A ||
+                        (opcode >= 0x40 && opcode <= 0xBF && (opcode & 0x07) == 6) ||
+                        (opcode == 0xCB && ((block->instructions[i].instruction >> 8) & 0x07) == 6);
+        if (indirect && (reads[i] & loop_writes)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Whether one of the loop's indirect reads currently hits DIV or TIMA
+bool CPU::idle_loop_reads_timer(const BasicBlock *block) {
+    for (const DecodedInstruction &op : block->instructions) {
+        uint8_t opcode = (op.instruction >> 16) & 0xFF;
+        uint16_t addr;
+        if (opcode == 0xF2) {
+            addr = 0xFF00 | regs[C_REGISTER];
+        } else if (opcode == 0x0A) {
+            addr = get_bc();
+        } else if (opcode == 0x1A) {
+            addr = get_de();
+        } else if ((opcode >= 0x40 && opcode <= 0xBF && (opcode & 0x07) == 6) ||
+                   (opcode == 0xCB && ((op.instruction >> 8) & 0x07) == 6)) {
+            addr = get_hl();
+        } else {
+            continue;
+        }
+        if (is_timer_counter(addr)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Called on entering an idle loop. After a full pass without leaving the
+// loop, the remaining passes before the end of the slice would all repeat
+// it exactly, so only their cycles are added. The pass that crosses the
+// slice end still runs, leaving the CPU exactly where stepping through
+// every pass would.
+void CPU::skip_idle_loop(const BasicBlock *block) {
+    uint32_t generation = block_cache->get_generation();
+    if (block == idle_block && generation == idle_generation && cycles > idle_entry_cycles &&
+        cycles < run_target && !idle_loop_reads_timer(block)) {
+        uint64_t pass = cycles - idle_entry_cycles;
+        uint64_t passes = (run_target - cycles - 1) / pass;
+        cycles += passes * pass;
+        idle_cycles_skipped += passes * pass;
+    }
+    idle_block = block;
+    idle_generation = generation;
+    idle_entry_cycles = cycles;
+}
+
+BasicBlock *CPU::decode_block(uint16_t start_pc) {
+    BasicBlock *block = new BasicBlock();
+    block->start_pc = start_pc;
+
+    uint16_t addr = start_pc;
+    while (block->instructions.size() < BlockCache::MAX_BLOCK_INSTRUCTIONS) {
+        if (!BlockCache::is_cacheable(addr)) {
+            break;
+        }
+        uint8_t opcode = bus->read_mem(addr);
+        uint8_t length = instruction_lengths[opcode];
+        // Operand bytes have to be covered by write invalidation as well
+        if (!BlockCache::is_cacheable(addr + length - 1)) {
+            break;
+        }
+
+        // Only keep the bytes that belong to the instruction, so that a
+        // cached word never depends on memory outside the block
+        uint32_t instruction = static_cast<uint32_t>(opcode) << 16;
+        if (length > 1) {
+            instruction |= static_cast<uint32_t>(bus->read_mem(addr + 1)) << 8;
+        }
+        if (length > 2) {
+            instruction |= static_cast<uint32_t>(bus->read_mem(addr + 2));
+        }
+
+        uint8_t index = (opcode == 0xCB) ? cb_opcode_index[(instruction >> 8) & 0xFF]
+                                         : opcode_index[opcode];
+        if (index == HANDLER_COUNT) {
+            break; // left to run() to report
+        }
+
+        block->instructions.push_back({instruction, addr, index, index, length, get_base_cycles(instruction)});
+        addr += length;
+        if (ends_block(index)) {
+            break;
+        }
+    }
+
+    if (block->instructions.empty()) {
+        delete block;
+        return nullptr;
+    }
+    block->end_pc = addr;
+    block->idle_loop = is_idle_loop(block);
+
+    // Fuse pairs from the left. The second of a pair keeps its own index
+    // for when a run() slice ends between the two.
+    std::vector<DecodedInstruction> &ops = block->instructions;
+    for (size_t i = 0; i + 1 < ops.size(); i++) {
+        ops[i].dispatch_index = fuse_pair(ops[i].handler_index, ops[i + 1].handler_index);
+        if (ops[i].dispatch_index != ops[i].handler_index) {
+            i++;
+        }
+    }
+    return block_cache->insert(block);
+}
+
+void CPU::enter_block() {
+    block_op = nullptr;
+    block_end = nullptr;
+#ifdef ENABLE_JIT
+    block_native = nullptr;
+#endif
+    const BasicBlock *last_idle_block = idle_block;
+    idle_block = nullptr;
+    if (!BlockCache::is_cacheable(pc)) {
         return;
     }
 
-	// check VBLANK interrupt
-    if (IH->is_VBLANK_interrupt() && (IE & 0x01)) {
-        mmu->push_stack(sp, pc);
-        sp -= 2;
-        cycles += 4;
-		pc = 0x0040; // VBLANK interrupt handler address
-		ime = false; // disable interrupts
-        IH->disable_VBLANK_interrupt();
+    BasicBlock *block = block_cache->lookup(pc);
+    if (!block) {
+        block = decode_block(pc);
     }
-    if (IH->is_STAT_interrupt() && (IE & 0x02)) {
-        mmu->push_stack(sp, pc);
-        sp -= 2;
-        cycles += 4;
-        pc = 0x0048; // STAT interrupt handler address
-        ime = false; // disable interrupts
-        IH->disable_STAT_interrupt();
+    if (block) {
+        block_op = block->instructions.data();
+        block_end = block_op + block->instructions.size();
+        block_generation = block_cache->get_generation();
+        if (block->idle_loop && skip_idle_loops) {
+            idle_block = last_idle_block;
+            skip_idle_loop(block);
+        }
+#ifdef ENABLE_JIT
+        if (jit) {
+            if (!block->native && ++block->hits == Jit::HOT_THRESHOLD) {
+                jit->compile(block, this);
+            }
+            block_native = block->native;
+            block_start = block_op;
+        }
+#endif
     }
-    if (IH->is_TIMER_interrupt() && (IE & 0x04)) {
-        mmu->push_stack(sp, pc);
-        sp -= 2;
-        cycles += 4;
-        pc = 0x0050; // TIMER interrupt handler address
-        ime = false; // disable interrupts
-        IH->disable_TIMER_interrupt();
-    }
-	if (IH->is_SERIAL_interrupt() && (IE & 0x08)) {
-		mmu->push_stack(sp, pc);
-		sp -= 2;
-		cycles += 4;
-		pc = 0x0058; // SERIAL interrupt handler address
-		ime = false; // disable interrupts
-		IH->disable_SERIAL_interrupt();
-	}
-	if (IH->is_JOYPAD_interrupt() && (IE & 0x10)) {
-		mmu->push_stack(sp, pc);
-		sp -= 2;
-		cycles += 4;
-		pc = 0x0060; // JOYPAD interrupt handler address
-		ime = false; // disable interrupts
-		IH->disable_JOYPAD_interrupt();
-	}
+}
+
+#ifdef ENABLE_JIT
+void CPU::run_native_block() {
+    if (!jit->usable()) {
+        block_native = nullptr; // the arena was lost: interpret
+        return;
+    }
+    uint32_t count = static_cast<uint32_t>(block_end - block_start);
+    uint32_t index = static_cast<uint32_t>(block_op - block_start);
+    block_op = block_start + jit->execute(this, block_start, count, index, block_native,
+                                          block_cache->get_generation_address());
+}
+#endif
+
+// run() is large enough that GCC stops inlining next_instruction() into
+// its labels on its own, which costs a call per dispatch
+#if defined(__GNUC__)
+#define CPU_ALWAYS_INLINE __attribute__((always_inline)) inline
+#else
+#define CPU_ALWAYS_INLINE inline
+#endif
+
+// Next instruction word and dispatch index for run(): the next entry of the
+// current block if the PC is still on it, otherwise a fresh fetch
+CPU_ALWAYS_INLINE uint8_t CPU::next_instruction(uint32_t &instruction) {
+    if (block_cache) {
+        // Check the generation before touching block_op, which may be freed
+        if (block_op == block_end || block_generation != block_cache->get_generation() ||
+            block_op->pc != pc) {
+            enter_block();
+        }
+#ifdef ENABLE_JIT
+        // Also when a slice ended inside the block
+        if (block_native && block_op != block_end) {
+            return NATIVE_BLOCK;
+        }
+#endif
+        if (block_op != block_end) {
+            instruction = block_op->instruction;
+            return (block_op++)->dispatch_index;
+        }
+    }
+
+    instruction = fetch_instruction();
+    uint8_t opcode = (instruction >> 16) & 0xFF;
+    return (opcode == 0xCB) ? cb_opcode_index[(instruction >> 8) & 0xFF] : opcode_index[opcode];
+}
+
+bool CPU::run(uint64_t target_cycles) {
+    uint32_t instruction = 0;
+    run_target = target_cycles;
+    // Events may have changed what a polling loop reads
+    idle_block = nullptr;
+
+    // Nothing runs until handle_interrupts() sees a requested interrupt,
+    // and only a scheduled event can request one: skip to the target
+    if (halted) {
+        if (cycles < target_cycles) {
+            cycles = target_cycles;
+        }
+        return true;
+    }
+
+#ifdef CPU_USE_COMPUTED_GOTO
+    // Threaded code: every handler label ends with its own fetch (or cached
+    // block step) and indirect jump, so each opcode gets a separately predicted branch. The handlers
+    // live in this translation unit and can be inlined into the labels.
+    // pc, sp and regs stay in the CPU object rather than in locals: the
+    // execute_* handlers, the bus slow path and the interrupt code all use
+    // the members, so locals would have to be written back around every
+    // handler that can leave the loop.
+#define HANDLER_LABEL(mnemonic, number) &&exec_##mnemonic##_##number,
+#define FUSED_LABEL(m1, n1, m2, n2) &&fused_##m1##_##n1##_##m2##_##n2,
+    static void *const handler_labels[FUSED_END] = {
+        CPU_INSTRUCTION_LIST(HANDLER_LABEL)
+        &&unknown_opcode,
+        &&native_block,
+        CPU_FUSED_LIST(FUSED_LABEL)
+    };
+#undef FUSED_LABEL
+#undef HANDLER_LABEL
+
+#define DISPATCH()                                      \
+    goto *handler_labels[next_instruction(instruction)]
+
+#define HANDLER_LABEL_BODY(mnemonic, number)            \
+    exec_##mnemonic##_##number: {                       \
+        EXECUTE_HANDLER(mnemonic, number);              \
+        if (cycles >= run_target) {                     \
+            return true;                                \
+        }                                               \
+        DISPATCH();                                     \
+    }
+
+    // A pair stops between its halves like any two instructions, with
+    // block_op left on the second
+#define FUSED_LABEL_BODY(m1, n1, m2, n2)                \
+    fused_##m1##_##n1##_##m2##_##n2: {                  \
+        EXECUTE_HANDLER(m1, n1);                        \
+        if (cycles >= run_target) {                     \
+            return true;                                \
+        }                                               \
+        instruction = (block_op++)->instruction;        \
+        EXECUTE_HANDLER(m2, n2);                        \
+        if (cycles >= run_target) {                     \
+            return true;                                \
+        }                                               \
+        DISPATCH();                                     \
+    }
+
+    DISPATCH();
+
+    CPU_INSTRUCTION_LIST(HANDLER_LABEL_BODY)
+    CPU_FUSED_LIST(FUSED_LABEL_BODY)
+
+native_block:
+#ifdef ENABLE_JIT
+    run_native_block();
+    if (cycles >= run_target) {
+        return true;
+    }
+    DISPATCH();
+#endif
+
+unknown_opcode:
+    return false;
+
+#undef FUSED_LABEL_BODY
+#undef HANDLER_LABEL_BODY
+#undef DISPATCH
+#else
+    // Portable fallback: one switch over the handler index
+#define HANDLER_CASE(mnemonic, number)                  \
+    case HANDLER_##mnemonic##_##number: {               \
+        EXECUTE_HANDLER(mnemonic, number);              \
+        break;                                          \
+    }
+
+#define FUSED_CASE(m1, n1, m2, n2)                      \
+    case FUSED_##m1##_##n1##_##m2##_##n2: {             \
+        EXECUTE_HANDLER(m1, n1);                        \
+        if (cycles >= run_target) {                     \
+            break;                                      \
+        }                                               \
+        instruction = (block_op++)->instruction;        \
+        EXECUTE_HANDLER(m2, n2);                        \
+        break;                                          \
+    }
+
+    do {
+        switch (next_instruction(instruction)) {
+            CPU_INSTRUCTION_LIST(HANDLER_CASE)
+            CPU_FUSED_LIST(FUSED_CASE)
+#ifdef ENABLE_JIT
+            case NATIVE_BLOCK:
+                run_native_block();
+                break;
+#endif
+            default:
+                return false;
+        }
+    } while (cycles < run_target);
+    return true;
 
+#undef FUSED_CASE
+#undef HANDLER_CASE
+#endif // CPU_USE_COMPUTED_GOTO
 }
 
 // DECODE
@@ -177,15 +889,17 @@ bool CPU::decode_LD_21(uint32_t instruction) {
 }
 
 bool CPU::decode_LD_22(uint32_t instruction) {
-    // LD r, (HL)
-    bool outcome = ((instruction >> 16) & 0xc7) == 0x46;
+    // LD r, (HL) (0x76 is HALT)
+    bool outcome = ((instruction >> 16) & 0xc7) == 0x46 &&
+                   (instruction >> 16) != 0x76;
 
     return outcome;
 }
 
 bool CPU::decode_LD_23(uint32_t instruction) {
-    // LD (HL), r
-    bool outcome = ((instruction >> 16) & 0xf8) == 0x70;
+    // LD (HL), r (0x76 is HALT)
+    bool outcome = ((instruction >> 16) & 0xf8) == 0x70 &&
+                   (instruction >> 16) != 0x76;
 
     return outcome;
 }
@@ -846,7 +1560,7 @@ void CPU::execute_LD_22(uint32_t instruction) {
     uint8_t operation = static_cast<uint8_t>((instruction >> 16) & 0xFF);
     uint8_t reg = (operation & 0b00111000) >> 3;
     uint16_t addr = get_hl(); // Get the HL register value
-    uint8_t data = mmu->read_mem(addr); 
+    uint8_t data = bus->read_mem(addr); 
 
     regs[reg] = data;
     pc++;
@@ -860,7 +1574,7 @@ void CPU::execute_LD_23(uint32_t instruction) {
     uint16_t addr = get_hl(); // Get the HL register value
     uint8_t data = regs[reg]; 
 
-   mmu->write_mem(addr, data);
+   bus->write_mem(addr, data);
    if (addr == 0xFF46) {
        // DMA transfer, adjust cycles
        cycles += 160;
@@ -875,7 +1589,7 @@ void CPU::execute_LD_24(uint32_t instruction) {
     uint16_t addr = get_hl(); // Get the HL register value
     uint8_t n = static_cast<uint8_t>((instruction >> 8) & 0xFF); // Get the immediate value
 
-    mmu->write_mem(addr, n);
+    bus->write_mem(addr, n);
     if (addr == 0xFF46) {
         // DMA transfer, adjust cycles
         cycles += 160;
@@ -887,7 +1601,7 @@ void CPU::execute_LD_24(uint32_t instruction) {
 void CPU::execute_LD_25(uint32_t instruction) {
     // LD A, (BC)
     uint16_t addr = get_bc(); // Get the BC register value
-    uint8_t data = mmu->read_mem(addr); 
+    uint8_t data = bus->read_mem(addr); 
 
     regs[A_REGISTER] = data;
     pc++;
@@ -897,7 +1611,7 @@ void CPU::execute_LD_25(uint32_t instruction) {
 void CPU::execute_LD_26(uint32_t instruction) {
     // LD A, (DE)
     uint16_t addr = get_de(); // Get the DE register value
-    uint8_t data = mmu->read_mem(addr); 
+    uint8_t data = bus->read_mem(addr); 
 
     regs[A_REGISTER] = data;
     pc++;
@@ -909,7 +1623,7 @@ void CPU::execute_LD_27(uint32_t instruction) {
     uint16_t addr = get_bc(); // Get the BC register value
     uint8_t data = regs[A_REGISTER]; 
 
-    mmu->write_mem(addr, data);
+    bus->write_mem(addr, data);
     if (addr == 0xFF46) {
         // DMA transfer, adjust cycles
         cycles += 160;
@@ -923,7 +1637,7 @@ void CPU::execute_LD_28(uint32_t instruction) {
     uint16_t addr = get_de(); // Get the DE register value
     uint8_t data = regs[A_REGISTER]; 
 
-    mmu->write_mem(addr, data);
+    bus->write_mem(addr, data);
     if (addr == 0xFF46) {
         // DMA transfer, adjust cycles
         cycles += 160;
@@ -939,7 +1653,7 @@ void CPU::execute_LD_29(uint32_t instruction) {
     uint16_t addr = msb;
     addr <<= 8;
     addr |= lsb; // Combine LSB and MSB to form the address
-    uint8_t data = mmu->read_mem(addr); 
+    uint8_t data = bus->read_mem(addr); 
 
     regs[A_REGISTER] = data;
     pc += 3; // one for instruction, two for imm
@@ -955,7 +1669,7 @@ void CPU::execute_LD_30(uint32_t instruction) {
     addr |= lsb; // Combine LSB and MSB to form the address
     uint8_t data = regs[A_REGISTER]; 
 
-    mmu->write_mem(addr, data);
+    bus->write_mem(addr, data);
     if (addr == 0xFF46) {
         // DMA transfer, adjust cycles
         cycles += 160;
@@ -969,7 +1683,7 @@ void CPU::execute_LD_31(uint32_t instruction) {
     uint8_t c_val = regs[C_REGISTER]; // Get the C register value
     uint16_t addr = 0xFF00 | c_val; // Address is 0xFF00 + C
 
-    uint8_t data = mmu->read_mem(addr); 
+    uint8_t data = bus->read_mem(addr); 
 
     regs[A_REGISTER] = data;
     pc++;
@@ -983,7 +1697,7 @@ void CPU::execute_LD_32(uint32_t instruction) {
 
     uint8_t data = regs[A_REGISTER]; 
 
-    mmu->write_mem(addr, data);
+    bus->write_mem(addr, data);
     if (addr == 0xFF46) {
         // DMA transfer, adjust cycles
         cycles += 160;
@@ -997,7 +1711,7 @@ void CPU::execute_LD_33(uint32_t instruction) {
     uint8_t n = static_cast<uint8_t>((instruction >> 8) & 0xFF); // Get the immediate value
     uint16_t addr = 0xFF00 | n; // Address is 0xFF00 + n
 
-    uint8_t data = mmu->read_mem(addr); 
+    uint8_t data = bus->read_mem(addr); 
     //std::cout << "Reading from address: " << std::hex << addr << std::endl;
     //std::cout << "Data: " << std::hex << static_cast<int>(data) << std::endl;
     //std::cout << "Register A: " << std::hex << static_cast<int>(regs[A_REGISTER]) << std::endl;
@@ -1013,7 +1727,7 @@ void CPU::execute_LD_34(uint32_t instruction) {
 
     uint8_t data = regs[A_REGISTER]; 
 
-    mmu->write_mem(addr, data);
+    bus->write_mem(addr, data);
     if (addr == 0xFF46) {
         // DMA transfer, adjust cycles
         cycles += 160;
@@ -1025,7 +1739,7 @@ void CPU::execute_LD_34(uint32_t instruction) {
 void CPU::execute_LD_35(uint32_t instruction) {
     // LD A, (HL-)
     uint16_t addr = get_hl(); // Get the HL register value
-    uint8_t data = mmu->read_mem(addr); 
+    uint8_t data = bus->read_mem(addr); 
 
     regs[A_REGISTER] = data;
 
@@ -1040,7 +1754,7 @@ void CPU::execute_LD_36(uint32_t instruction) {
     uint16_t addr = get_hl(); // Get the HL register value
     uint8_t data = regs[A_REGISTER]; 
 
-    mmu->write_mem(addr, data);
+    bus->write_mem(addr, data);
     if (addr == 0xFF46) {
         // DMA transfer, adjust cycles
         cycles += 160;
@@ -1055,7 +1769,7 @@ void CPU::execute_LD_36(uint32_t instruction) {
 void CPU::execute_LD_37(uint32_t instruction) {
     // LD A, (HL+)
     uint16_t addr = get_hl(); // Get the HL register value
-    uint8_t data = mmu->read_mem(addr); 
+    uint8_t data = bus->read_mem(addr); 
 
     regs[A_REGISTER] = data;
 
@@ -1073,7 +1787,7 @@ void CPU::execute_LD_38(uint32_t instruction)
     //std::cout << "HELLO! In LD 38\n" << "PC is: " << std::hex << pc << '\n';
 	//std::cout << "Storing data " << std::hex << (int)data << " at address: " << std::hex << addr << "\n\n";
 
-    mmu->write_mem(addr, data);
+    bus->write_mem(addr, data);
     if (addr == 0xFF46) {
         // DMA transfer, adjust cycles
         cycles += 160;
@@ -1092,14 +1806,10 @@ void CPU::execute_LD_39(uint32_t instruction) {
 
     uint8_t reg = (operation & 0b00110000) >> 4;
 
-    if (reg == 0) {
-        set_bc(nn); // LD BC, nn
-    } else if (reg == 1) {
-        set_de(nn); // LD DE, nn
-    } else if (reg == 2) {
-        set_hl(nn); // LD HL, nn
-    } else if (reg == 3) {
+    if (reg == 3) {
         sp = nn; // LD SP, nn
+    } else {
+        set_pair(reg, nn); // LD BC, DE, HL, nn
     }
     pc += 3; // one for instruction, two for imm
     cycles += 3;
@@ -1113,8 +1823,8 @@ void CPU::execute_LD_40(uint32_t instruction) {
     addr <<= 8;
     addr |= lsb; // Combine LSB and MSB to form the address
 
-    mmu->write_mem(addr, static_cast<uint8_t>(sp & 0xFF)); // Store LSB of SP
-    mmu->write_mem(addr + 1, static_cast<uint8_t>((sp >> 8) & 0xFF)); // Store MSB of SP
+    bus->write_mem(addr, static_cast<uint8_t>(sp & 0xFF)); // Store LSB of SP
+    bus->write_mem(addr + 1, static_cast<uint8_t>((sp >> 8) & 0xFF)); // Store MSB of SP
     pc += 3; // one for instruction, two for imm
     cycles += 5;
 }
@@ -1141,7 +1851,7 @@ void CPU::execute_PUSH_42(uint32_t instruction) {
     }
 
     // Push the value of rr onto the stack
-    mmu->push_stack(sp, rr);
+    bus->push_stack(sp, rr);
     sp -= 2;
 
     pc++;
@@ -1154,7 +1864,7 @@ void CPU::execute_POP_43(uint32_t instruction) {
     uint16_t data;
 
     // Pop the value from the stack into rr
-    data = mmu->pop_stack(sp);
+    data = bus->pop_stack(sp);
     sp += 2;
 
     if (((operation & 0b00110000) >> 4) == 0) {
@@ -1193,17 +1903,10 @@ void CPU::execute_ADD_45(uint32_t instruction) {
 
     uint8_t a_val = regs[A_REGISTER];
 
-    // Two additions for flag setting
-    uint16_t result16 = static_cast<uint16_t>(a_val) + static_cast<uint16_t>(data);
-    uint8_t result8 = static_cast<uint8_t>(result16);
+    uint8_t result8 = a_val + data;
 
-    // Calculate and set flags
-    set_flag(Z_FLAG_BIT, result8 == 0);
-    set_flag(N_FLAG_BIT, false);
-    // Half Carry: Check carry from bit 3 to bit 4
-    set_flag(H_FLAG_BIT, ((a_val & 0x0F) + (data & 0x0F)) > 0x0F);
-    // Carry: Check carry from bit 7
-    set_flag(C_FLAG_BIT, result16 > 0xFF);
+    // Set flags
+    set_table_flags(result8, false, ADD_FLAGS.entries[a_val][data]);
 
     // Store result back in A register
     regs[A_REGISTER] = result8;
@@ -1216,18 +1919,14 @@ void CPU::execute_ADD_45(uint32_t instruction) {
 void CPU::execute_ADD_46(uint32_t instruction) {
     // ADD A, (HL) - Opcode 0b10000110/0x86
     uint16_t addr = get_hl();
-    uint8_t data = mmu->read_mem(addr); 
+    uint8_t data = bus->read_mem(addr); 
     
     uint8_t a_val = regs[A_REGISTER];
 
-    uint16_t result16 = static_cast<uint16_t>(a_val) + static_cast<uint16_t>(data);
-    uint8_t result8 = static_cast<uint8_t>(result16);
+    uint8_t result8 = a_val + data;
 
     // Set flags
-    set_flag(Z_FLAG_BIT, result8 == 0);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, ((a_val & 0x0F) + (data & 0x0F)) > 0x0F);
-    set_flag(C_FLAG_BIT, result16 > 0xFF);
+    set_table_flags(result8, false, ADD_FLAGS.entries[a_val][data]);
 
     regs[A_REGISTER] = result8;
     pc++;
@@ -1240,14 +1939,10 @@ void CPU::execute_ADD_47(uint32_t instruction) {
     uint8_t n = static_cast<uint8_t>((instruction >> 8) & 0xFF);;
     uint8_t a_val = regs[A_REGISTER];
 
-    uint16_t result16 = static_cast<uint16_t>(a_val) + static_cast<uint16_t>(n);
-    uint8_t result8 = static_cast<uint8_t>(result16);
+    uint8_t result8 = a_val + n;
 
     // Set flags
-    set_flag(Z_FLAG_BIT, result8 == 0); // Z = 1 if result is 0
-    set_flag(N_FLAG_BIT, false);       // N = 0 for ADD
-    set_flag(H_FLAG_BIT, ((a_val & 0x0F) + (n & 0x0F)) > 0x0F); // H = 1 if carry from bit 3
-    set_flag(C_FLAG_BIT, result16 > 0xFF); // C = 1 if carry from bit 7
+    set_table_flags(result8, false, ADD_FLAGS.entries[a_val][n]);
 
     regs[A_REGISTER] = result8;
     pc += 2;
@@ -1278,10 +1973,7 @@ void CPU::execute_ADC_48(uint32_t instruction) {
     uint8_t result8 = static_cast<uint8_t>(result16);
 
     // Set flags
-    set_flag(Z_FLAG_BIT, result8 == 0);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, ((a_val & 0x0F) + (r_val & 0x0F) + carry) > 0x0F);
-    set_flag(C_FLAG_BIT, result16 > 0xFF);
+    set_alu_flags(result8, false, a_val ^ r_val ^ result8, result16 > 0xFF);
 
     regs[A_REGISTER] = result8;
     pc++;
@@ -1292,7 +1984,7 @@ void CPU::execute_ADC_49(uint32_t instruction) {
     // ADC A, (HL) - Opcode 0x8E, 1-byte instruction.
 
     uint16_t addr = get_hl();
-    uint8_t data = mmu->read_mem(addr);
+    uint8_t data = bus->read_mem(addr);
     uint8_t a_val = regs[A_REGISTER];
     uint8_t carry = get_flag(C_FLAG_BIT) ? 1 : 0;
 
@@ -1300,10 +1992,7 @@ void CPU::execute_ADC_49(uint32_t instruction) {
     uint8_t result8 = static_cast<uint8_t>(result16);
 
     // Set flags
-    set_flag(Z_FLAG_BIT, result8 == 0);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, ((a_val & 0x0F) + (data & 0x0F) + carry) > 0x0F);
-    set_flag(C_FLAG_BIT, result16 > 0xFF);
+    set_alu_flags(result8, false, a_val ^ data ^ result8, result16 > 0xFF);
 
     regs[A_REGISTER] = result8;
     pc++;
@@ -1321,10 +2010,7 @@ void CPU::execute_ADC_50(uint32_t instruction) {
     uint8_t result8 = static_cast<uint8_t>(result16);
 
     // Set flags
-    set_flag(Z_FLAG_BIT, result8 == 0);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, ((a_val & 0x0F) + (n & 0x0F) + carry) > 0x0F);
-    set_flag(C_FLAG_BIT, result16 > 0xFF);
+    set_alu_flags(result8, false, a_val ^ n ^ result8, result16 > 0xFF);
 
     regs[A_REGISTER] = result8;
     pc += 2;
@@ -1352,10 +2038,7 @@ void CPU::execute_SUB_51(uint32_t instruction) {
     uint8_t result8 = a_val - r_val;
 
     // Set flags
-    set_flag(Z_FLAG_BIT, result8 == 0);
-    set_flag(N_FLAG_BIT, true);
-    set_flag(H_FLAG_BIT, (a_val & 0x0F) < (r_val & 0x0F));
-    set_flag(C_FLAG_BIT, a_val < r_val);
+    set_table_flags(result8, true, SUB_FLAGS.entries[a_val][r_val]);
 
     regs[A_REGISTER] = result8;
     pc++;
@@ -1366,16 +2049,13 @@ void CPU::execute_SUB_52(uint32_t instruction) {
     // SUB A, (HL) - Opcode 0x96, 1-byte instruction.
     uint16_t addr = get_hl();
 
-    uint8_t data = mmu->read_mem(addr);
+    uint8_t data = bus->read_mem(addr);
     uint8_t a_val = regs[A_REGISTER];
 
     uint8_t result8 = a_val - data;
 
     // Set flags
-    set_flag(Z_FLAG_BIT, result8 == 0);
-    set_flag(N_FLAG_BIT, true);
-    set_flag(H_FLAG_BIT, (a_val & 0x0F) < (data & 0x0F));
-    set_flag(C_FLAG_BIT, a_val < data);
+    set_table_flags(result8, true, SUB_FLAGS.entries[a_val][data]);
 
     regs[A_REGISTER] = result8;
     pc++;
@@ -1390,10 +2070,7 @@ void CPU::execute_SUB_53(uint32_t instruction) {
     uint8_t result8 = a_val - n;
 
     // Set flags
-    set_flag(Z_FLAG_BIT, result8 == 0);
-    set_flag(N_FLAG_BIT, true);
-    set_flag(H_FLAG_BIT, (a_val & 0x0F) < (n & 0x0F));
-    set_flag(C_FLAG_BIT, a_val < n);
+    set_table_flags(result8, true, SUB_FLAGS.entries[a_val][n]);
 
     regs[A_REGISTER] = result8;
     pc += 2;
@@ -1424,10 +2101,7 @@ void CPU::execute_SBC_54(uint32_t instruction) {
     uint8_t result8 = a_val - static_cast<uint8_t>(temp_sub); // Perform subtraction
 
     // Set flags
-    set_flag(Z_FLAG_BIT, result8 == 0);
-    set_flag(N_FLAG_BIT, true);
-    set_flag(H_FLAG_BIT, (a_val & 0x0F) < (r_val & 0x0F) + carry);
-    set_flag(C_FLAG_BIT, static_cast<uint16_t>(a_val) < temp_sub);
+    set_alu_flags(result8, true, a_val ^ r_val ^ result8, static_cast<uint16_t>(a_val) < temp_sub);
 
     regs[A_REGISTER] = result8;
     pc++;
@@ -1438,7 +2112,7 @@ void CPU::execute_SBC_55(uint32_t instruction) {
     // SBC A, (HL) - Opcode 0x9E, 1-byte instruction
 
     uint16_t addr = get_hl();
-    uint8_t data = mmu->read_mem(addr);
+    uint8_t data = bus->read_mem(addr);
 
     uint8_t a_val = regs[A_REGISTER];
     uint8_t carry = get_flag(C_FLAG_BIT) ? 1 : 0;
@@ -1447,10 +2121,7 @@ void CPU::execute_SBC_55(uint32_t instruction) {
     uint8_t result8 = a_val - static_cast<uint8_t>(temp_sub); // Perform subtraction
 
     // Set flags
-    set_flag(Z_FLAG_BIT, result8 == 0);
-    set_flag(N_FLAG_BIT, true);
-    set_flag(H_FLAG_BIT, (a_val & 0x0F) < (data & 0x0F) + carry);
-    set_flag(C_FLAG_BIT, static_cast<uint16_t>(a_val) < temp_sub);
+    set_alu_flags(result8, true, a_val ^ data ^ result8, static_cast<uint16_t>(a_val) < temp_sub);
 
     regs[A_REGISTER] = result8;
     pc++;
@@ -1467,10 +2138,7 @@ void CPU::execute_SBC_56(uint32_t instruction) {
     uint8_t result8 = a_val - static_cast<uint8_t>(temp_sub); // Perform subtraction
 
     // Set flags
-    set_flag(Z_FLAG_BIT, result8 == 0);
-    set_flag(N_FLAG_BIT, true);
-    set_flag(H_FLAG_BIT, (a_val & 0x0F) < (n & 0x0F) + carry);
-    set_flag(C_FLAG_BIT, static_cast<uint16_t>(a_val) < temp_sub);
+    set_alu_flags(result8, true, a_val ^ n ^ result8, static_cast<uint16_t>(a_val) < temp_sub);
 
     regs[A_REGISTER] = result8;
     pc += 2;
@@ -1497,10 +2165,7 @@ void CPU::execute_CP_57(uint32_t instruction) {
     uint8_t result8 = a_val - r_val; // Temporary result for Z flag
 
     // Set flags
-    set_flag(Z_FLAG_BIT, result8 == 0);
-    set_flag(N_FLAG_BIT, true);
-    set_flag(H_FLAG_BIT, (a_val & 0x0F) < (r_val & 0x0F));
-    set_flag(C_FLAG_BIT, a_val < r_val);
+    set_table_flags(result8, true, SUB_FLAGS.entries[a_val][r_val]);
 
     pc++;
     cycles += 1;
@@ -1510,16 +2175,13 @@ void CPU::execute_CP_58(uint32_t instruction) {
     // CP A, (HL) - Opcode 0xBE, 1-byte instruction.
 
     uint16_t addr = get_hl();
-    uint8_t data = mmu->read_mem(addr);
+    uint8_t data = bus->read_mem(addr);
 
     uint8_t a_val = regs[A_REGISTER];
     uint8_t result8 = a_val - data; // Temporary result for Z flag
 
     // Set flags
-    set_flag(Z_FLAG_BIT, result8 == 0);
-    set_flag(N_FLAG_BIT, true);
-    set_flag(H_FLAG_BIT, (a_val & 0x0F) < (data & 0x0F));
-    set_flag(C_FLAG_BIT, a_val < data);
+    set_table_flags(result8, true, SUB_FLAGS.entries[a_val][data]);
 
     pc++;
     cycles += 2;
@@ -1532,10 +2194,7 @@ void CPU::execute_CP_59(uint32_t instruction) {
     uint8_t result8 = a_val - n;
 
     // Set flags
-    set_flag(Z_FLAG_BIT, result8 == 0);
-    set_flag(N_FLAG_BIT, true);
-    set_flag(H_FLAG_BIT, (a_val & 0x0F) < (n & 0x0F));
-    set_flag(C_FLAG_BIT, a_val < n);
+    set_table_flags(result8, true, SUB_FLAGS.entries[a_val][n]);
 
     pc += 2;
     cycles += 2;
@@ -1553,10 +2212,7 @@ void CPU::execute_INC_60(uint32_t instruction) {
     }
 
     // Set flags
-    set_flag(Z_FLAG_BIT, new_val == 0);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, ((old_val & 0x0F) + 1) > 0x0F);
-    // no change to C flag
+    set_table_flags_keep_c(new_val, false, INC_FLAGS.entries[old_val]);
 
     regs[target_reg_index] = new_val;
     pc++;
@@ -1567,16 +2223,13 @@ void CPU::execute_INC_61(uint32_t instruction) {
     // INC (HL) - Opcode 0x34, 1-byte instruction
 
     uint16_t addr = get_hl();
-    uint8_t old_val = mmu->read_mem(addr);
+    uint8_t old_val = bus->read_mem(addr);
     uint8_t new_val = old_val + 1;
 
     // Set flags
-    set_flag(Z_FLAG_BIT, new_val == 0);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, ((old_val & 0x0F) + 1) > 0x0F);
-    // no change to C flag
+    set_table_flags_keep_c(new_val, false, INC_FLAGS.entries[old_val]);
 
-    mmu->write_mem(addr, new_val);
+    bus->write_mem(addr, new_val);
     if (addr == 0xFF46) {
         // DMA transfer, adjust cycles
         cycles += 160;
@@ -1597,9 +2250,7 @@ void CPU::execute_DEC_62(uint32_t instruction) {
     }
 
     // Set flags
-    set_flag(Z_FLAG_BIT, new_val == 0);
-    set_flag(N_FLAG_BIT, true);
-    set_flag(H_FLAG_BIT, (old_val & 0x0F) == 0x00);
+    set_table_flags_keep_c(new_val, true, DEC_FLAGS.entries[old_val]);
 
     regs[target_reg_index] = new_val;
     pc++;
@@ -1610,15 +2261,13 @@ void CPU::execute_DEC_63(uint32_t instruction) {
     // DEC (HL) - Opcode 0x35, 1-byte instruction
 
     uint16_t addr = get_hl();
-    uint8_t old_val = mmu->read_mem(addr);
+    uint8_t old_val = bus->read_mem(addr);
     uint8_t new_val = old_val - 1;
 
     // Set flags
-    set_flag(Z_FLAG_BIT, new_val == 0);
-    set_flag(N_FLAG_BIT, true);
-    set_flag(H_FLAG_BIT, (old_val & 0x0F) == 0x00);
+    set_table_flags_keep_c(new_val, true, DEC_FLAGS.entries[old_val]);
 
-    mmu->write_mem(addr, new_val);
+    bus->write_mem(addr, new_val);
     if (addr == 0xFF46) {
         // DMA transfer, adjust cycles
         cycles += 160;
@@ -1648,10 +2297,7 @@ void CPU::execute_AND_64(uint32_t instruction) {
     uint8_t result8 = a_val & r_val;
 
     // Set flags
-    set_flag(Z_FLAG_BIT, result8 == 0);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, true);
-    set_flag(C_FLAG_BIT, false);
+    set_alu_flags(result8, false, 0x10, false);
 
     regs[A_REGISTER] = result8;
     pc++;
@@ -1661,15 +2307,12 @@ void CPU::execute_AND_64(uint32_t instruction) {
 void CPU::execute_AND_65(uint32_t instruction) {
     // AND A, (HL) - Opcode 0xA6,  1-byte instruction
     uint16_t addr = get_hl();
-    uint8_t data = mmu->read_mem(addr);
+    uint8_t data = bus->read_mem(addr);
     uint8_t a_val = regs[A_REGISTER];
     uint8_t result8 = a_val & data;
 
     // Set flags
-    set_flag(Z_FLAG_BIT, result8 == 0);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, true);
-    set_flag(C_FLAG_BIT, false);
+    set_alu_flags(result8, false, 0x10, false);
 
     regs[A_REGISTER] = result8;
     pc++;
@@ -1683,10 +2326,7 @@ void CPU::execute_AND_66(uint32_t instruction) {
     uint8_t result8 = a_val & n;
 
     // Set flags
-    set_flag(Z_FLAG_BIT, result8 == 0);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, true);
-    set_flag(C_FLAG_BIT, false);
+    set_alu_flags(result8, false, 0x10, false);
 
     regs[A_REGISTER] = result8;
     pc += 2;
@@ -1713,10 +2353,7 @@ void CPU::execute_OR_67(uint32_t instruction) {
     uint8_t result8 = a_val | r_val;
 
     // Set flags
-    set_flag(Z_FLAG_BIT, result8 == 0);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, false);
-    set_flag(C_FLAG_BIT, false);
+    set_alu_flags(result8, false, 0x00, false);
 
     regs[A_REGISTER] = result8;
     pc++;
@@ -1727,15 +2364,12 @@ void CPU::execute_OR_68(uint32_t instruction) {
     // OR A, (HL) - Opcode 0xB6, 1-byte instruction
     uint16_t addr = get_hl();
 
-    uint8_t data = mmu->read_mem(addr);
+    uint8_t data = bus->read_mem(addr);
     uint8_t a_val = regs[A_REGISTER];
     uint8_t result8 = a_val | data;
 
     // Set flags
-    set_flag(Z_FLAG_BIT, result8 == 0);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, false);
-    set_flag(C_FLAG_BIT, false);
+    set_alu_flags(result8, false, 0x00, false);
 
     regs[A_REGISTER] = result8;
     pc++;
@@ -1749,10 +2383,7 @@ void CPU::execute_OR_69(uint32_t instruction) {
     uint8_t result8 = a_val | n;
 
     // Set flags
-    set_flag(Z_FLAG_BIT, result8 == 0);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, false);
-    set_flag(C_FLAG_BIT, false);
+    set_alu_flags(result8, false, 0x00, false);
 
     regs[A_REGISTER] = result8;
     pc += 2;
@@ -1780,10 +2411,7 @@ void CPU::execute_XOR_70(uint32_t instruction) {
     uint8_t result8 = a_val ^ r_val;
 
     // Set flags
-    set_flag(Z_FLAG_BIT, result8 == 0);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, false);
-    set_flag(C_FLAG_BIT, false);
+    set_alu_flags(result8, false, 0x00, false);
 
     regs[A_REGISTER] = result8;
     pc++;
@@ -1795,15 +2423,12 @@ void CPU::execute_XOR_71(uint32_t instruction) {
     // Assumption: pc points to the opcode itself on entry.
 
     uint16_t addr = get_hl();
-    uint8_t data = mmu->read_mem(addr);
+    uint8_t data = bus->read_mem(addr);
     uint8_t a_val = regs[A_REGISTER];
     uint8_t result8 = a_val ^ data;
 
     // Set flags
-    set_flag(Z_FLAG_BIT, result8 == 0);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, false);
-    set_flag(C_FLAG_BIT, false);
+    set_alu_flags(result8, false, 0x00, false);
 
     regs[A_REGISTER] = result8;
     pc++;
@@ -1814,13 +2439,13 @@ void CPU::execute_XOR_71(uint32_t instruction) {
 void CPU::execute_XOR_72(uint32_t instruction) {
     uint8_t n = static_cast<uint8_t>((instruction >> 8) & 0xFF);
 
-    regs[A_REGISTER] ^= n;
+    uint8_t a_val = regs[A_REGISTER];
+    uint8_t result8 = a_val ^ n;
 
     // Set flags
-    set_flag(Z_FLAG_BIT, regs[A_REGISTER] == 0);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, false);
-    set_flag(C_FLAG_BIT, false);
+    set_alu_flags(result8, false, 0x00, false);
+
+    regs[A_REGISTER] = result8;
 
     pc += 2; // 2-byte instruction
     cycles += 2;
@@ -1845,43 +2470,13 @@ void CPU::execute_SCF_74(uint32_t instruction) {
 }
 
 void CPU::execute_DAA_75(uint32_t instruction) {
-    uint8_t a_val = regs[A_REGISTER];
-    uint16_t correction = 0;
-    bool original_c = get_flag(C_FLAG_BIT); // Store original C flag
-    bool set_c_flag = false;
-
-    if (get_flag(N_FLAG_BIT)) {
-        // If the previous subtraction caused a borrow (C flag set)
-        if (original_c) {
-            correction |= 0x60;
-            set_c_flag = true;
-        }
-        // If the previous subtraction caused a half-borrow (H flag set)
-        if (get_flag(H_FLAG_BIT)) {
-            correction |= 0x06;
-        }
-        a_val -= static_cast<uint8_t>(correction);
-    } else {
-        // Check if lower nibble needs correction or if Half Carry was set
-        if (get_flag(H_FLAG_BIT) || (a_val & 0x0F) > 0x09) {
-            correction |= 0x06;
-        }
-        // Check if upper nibble needs correction or if original Carry was set
-        if (original_c || a_val > 0x99) {
-            correction |= 0x60;
-            set_c_flag = true; // DAA sets the Carry flag if upper nibble needed correction
-        }
-        a_val += static_cast<uint8_t>(correction);
-    }
+    // Correction and carry from the table, by N, H and C
+    int flags = (flag_n << 2) | (((flag_half >> 4) & 1) << 1) | flag_c;
+    uint16_t entry = DAA_TABLE.entries[flags][regs[A_REGISTER]];
+    regs[A_REGISTER] = static_cast<uint8_t>(entry);
 
-    // Update A register
-    regs[A_REGISTER] = a_val;
-
-    // Set flags
-    set_flag(Z_FLAG_BIT, (a_val == 0)); // Z is set if result is 0
-    set_flag(H_FLAG_BIT, false);       // H is always reset
-    set_flag(C_FLAG_BIT, set_c_flag);  // C is set based on the DAA logic above
-    // N flag remains unchanged
+    // Z from the result, H reset, N unchanged
+    set_alu_flags(static_cast<uint8_t>(entry), flag_n, 0, entry & ALU_CARRY);
 
     pc++;      // 1-byte instruction
     cycles += 1; // 1 M-cycle
@@ -1898,19 +2493,11 @@ void CPU::execute_CPL_76(uint32_t instruction) {
 }
 
 void CPU::execute_INC_77(uint32_t instruction) {
-    switch ((instruction >> 20) & 0b11) {
-        case 0b00: // INC BC
-            set_bc(get_bc() + 1);
-            break;
-        case 0b01: // INC DE
-            set_de(get_de() + 1);
-            break;
-        case 0b10: // INC HL
-            set_hl(get_hl() + 1);
-            break;
-        case 0b11: // INC SP
-            sp++;
-            break;
+    int rr = (instruction >> 20) & 0b11;
+    if (rr == 0b11) {
+        sp++; // INC SP
+    } else {
+        set_pair(rr, get_pair(rr) + 1); // INC BC, DE, HL
     }
 
     pc++;
@@ -1918,19 +2505,11 @@ void CPU::execute_INC_77(uint32_t instruction) {
 }
 
 void CPU::execute_DEC_78(uint32_t instruction) {
-    switch ((instruction >> 20) & 0b11) {
-        case 0b00: // DEC BC
-            set_bc(get_bc() - 1);
-            break;
-        case 0b01: // DEC DE
-            set_de(get_de() - 1);
-            break;
-        case 0b10: // DEC HL
-            set_hl(get_hl() - 1);
-            break;
-        case 0b11: // DEC SP
-            sp--;
-            break;
+    int rr = (instruction >> 20) & 0b11;
+    if (rr == 0b11) {
+        sp--; // DEC SP
+    } else {
+        set_pair(rr, get_pair(rr) - 1); // DEC BC, DE, HL
     }
 
     pc++;
@@ -1939,21 +2518,8 @@ void CPU::execute_DEC_78(uint32_t instruction) {
 
 void CPU::execute_ADD_79(uint32_t instruction) { // ADD HL, rr
     uint16_t hl = get_hl();
-    uint16_t rr;
-    switch ((instruction >> 20) & 0b11) {
-        case 0b00: // ADD HL, BC
-            rr = get_bc();
-            break;
-        case 0b01: // ADD HL, DE
-            rr = get_de();
-            break;
-        case 0b10: // ADD HL, HL
-            rr = get_hl();
-            break;
-        case 0b11: // ADD HL, SP
-            rr = sp;
-            break;
-    }
+    int pair = (instruction >> 20) & 0b11;
+    uint16_t rr = (pair == 0b11) ? sp : get_pair(pair); // BC, DE, HL or SP
 
     uint32_t result = static_cast<uint32_t>(hl) + static_cast<uint32_t>(rr); // larger result to calculate flags
     set_hl(static_cast<uint16_t>(result));
@@ -1984,96 +2550,57 @@ void CPU::execute_ADD_80(uint32_t instruction) { // ADD SP, e
 }
 
 void CPU::execute_RLCA_82(uint32_t instruction) {
-    uint8_t a_val = regs[A_REGISTER];
-    bool carry = a_val & 0x80; // Check if the highest bit is set
-
-    // Rotate left
-    a_val = (a_val << 1) | carry;
-
-    // Set flags
-    set_flag(Z_FLAG_BIT, false);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, false);
-    set_flag(C_FLAG_BIT, carry);
-
-    regs[A_REGISTER] = a_val;
+    // Same as the CB form on A, except that Z is always reset
+    uint16_t entry = SHIFT_TABLE.entries[SHIFT_RLC][0][regs[A_REGISTER]];
+    regs[A_REGISTER] = static_cast<uint8_t>(entry);
+    set_alu_flags(1, false, 0, entry & ALU_CARRY);
 
     pc++;
     cycles += 1;
 }
 
 void CPU::execute_RRCA_83(uint32_t instruction) {
-    uint8_t a_val = regs[A_REGISTER];
-    bool carry = a_val & 0x01; // Check if the lowest bit is set
-
-    // Rotate right
-    a_val = (a_val >> 1) | (carry << 7);
-
-    // Set flags
-    set_flag(Z_FLAG_BIT, false);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, false);
-    set_flag(C_FLAG_BIT, carry);
-
-    regs[A_REGISTER] = a_val;
+    // Same as the CB form on A, except that Z is always reset
+    uint16_t entry = SHIFT_TABLE.entries[SHIFT_RRC][0][regs[A_REGISTER]];
+    regs[A_REGISTER] = static_cast<uint8_t>(entry);
+    set_alu_flags(1, false, 0, entry & ALU_CARRY);
 
     pc++;
     cycles += 1;
 }
 
 void CPU::execute_RLA_84(uint32_t instruction) {
-    uint8_t a_val = regs[A_REGISTER];
-    bool carry = get_flag(C_FLAG_BIT); // Get the carry flag
-
-    // Set flags
-    set_flag(Z_FLAG_BIT, false);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, false);
-    set_flag(C_FLAG_BIT, a_val & 0x80); // Set carry if the highest bit is set
-
-    // Rotate left through carry
-    a_val = (a_val << 1) | carry;
-
-    regs[A_REGISTER] = a_val;
+    // Same as the CB form on A, except that Z is always reset
+    uint16_t entry = SHIFT_TABLE.entries[SHIFT_RL][flag_c][regs[A_REGISTER]];
+    regs[A_REGISTER] = static_cast<uint8_t>(entry);
+    set_alu_flags(1, false, 0, entry & ALU_CARRY);
 
     pc++;
     cycles += 1;
 }
 
 void CPU::execute_RRA_85(uint32_t instruction) {
-    uint8_t a_val = regs[A_REGISTER];
-    bool carry = get_flag(C_FLAG_BIT); // Get the carry flag
-
-    // Set flags
-    set_flag(Z_FLAG_BIT, false);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, false);
-    set_flag(C_FLAG_BIT, a_val & 0x01); // Set carry if the lowest bit is set
-
-    // Rotate right through carry
-    a_val = (a_val >> 1) | (carry << 7);
-
-    regs[A_REGISTER] = a_val;
+    // Same as the CB form on A, except that Z is always reset
+    uint16_t entry = SHIFT_TABLE.entries[SHIFT_RR][flag_c][regs[A_REGISTER]];
+    regs[A_REGISTER] = static_cast<uint8_t>(entry);
+    set_alu_flags(1, false, 0, entry & ALU_CARRY);
 
     pc++;
     cycles += 1;
 }
 
+// Rotate or shift through the table, setting Z, N, H and C. Only RL and RR
+// read the old carry, so the others don't wait on the previous flags.
+uint8_t CPU::shift(int op, uint8_t value) {
+    bool carry_in = (op == SHIFT_RL || op == SHIFT_RR) && flag_c;
+    uint16_t entry = SHIFT_TABLE.entries[op][carry_in][value];
+    set_alu_flags(static_cast<uint8_t>(entry), false, 0, entry & ALU_CARRY);
+    return static_cast<uint8_t>(entry);
+}
+
 void CPU::execute_RLC_86(uint32_t instruction) {
     uint8_t regNum = (instruction >> 8) & 0b111;
-    uint8_t reg = regs[regNum];
-    bool carry = reg & 0x80; // Check if the highest bit is set
-
-    // Rotate left
-    reg = (reg << 1) | carry;
-
-    // Set flags
-    set_flag(Z_FLAG_BIT, reg == 0);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, false);
-    set_flag(C_FLAG_BIT, carry);
-
-    regs[regNum] = reg;
+    regs[regNum] = shift(SHIFT_RLC, regs[regNum]);
 
     pc += 2; // 2-byte instruction
     cycles += 2;
@@ -2081,19 +2608,7 @@ void CPU::execute_RLC_86(uint32_t instruction) {
 
 void CPU::execute_RLC_87(uint32_t instruction) {
     uint16_t addr = get_hl();
-    uint8_t hl = mmu->read_mem(addr);
-    bool carry = hl & 0x80; // Check if the highest bit is set
-
-    // Rotate left
-    hl = (hl << 1) | carry;
-
-    // Set flags
-    set_flag(Z_FLAG_BIT, hl == 0);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, false);
-    set_flag(C_FLAG_BIT, carry);
-
-    mmu->write_mem(addr, hl);
+    bus->write_mem(addr, shift(SHIFT_RLC, bus->read_mem(addr)));
     if (addr == 0xFF46) {
         // DMA transfer, adjust cycles
         cycles += 160;
@@ -2105,19 +2620,7 @@ void CPU::execute_RLC_87(uint32_t instruction) {
 
 void CPU::execute_RRC_88(uint32_t instruction) {
     uint8_t regNum = (instruction >> 8) & 0b111;
-    uint8_t reg = regs[regNum];
-    bool carry = reg & 0x01; // Check if the lowest bit is set
-
-    // Rotate right
-    reg = (reg >> 1) | (carry << 7);
-
-    // Set flags
-    set_flag(Z_FLAG_BIT, reg == 0);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, false);
-    set_flag(C_FLAG_BIT, carry);
-
-    regs[regNum] = reg;
+    regs[regNum] = shift(SHIFT_RRC, regs[regNum]);
 
     pc += 2; // 2-byte instruction
     cycles += 2;
@@ -2125,19 +2628,7 @@ void CPU::execute_RRC_88(uint32_t instruction) {
 
 void CPU::execute_RRC_89(uint32_t instruction) {
     uint16_t addr = get_hl();
-    uint8_t hl = mmu->read_mem(addr);
-    bool carry = hl & 0x01; // Check if the lowest bit is set
-
-    // Rotate right
-    hl = (hl >> 1) | (carry << 7);
-
-    // Set flags
-    set_flag(Z_FLAG_BIT, hl == 0);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, false);
-    set_flag(C_FLAG_BIT, carry);
-
-    mmu->write_mem(addr, hl);
+    bus->write_mem(addr, shift(SHIFT_RRC, bus->read_mem(addr)));
     if (addr == 0xFF46) {
         // DMA transfer, adjust cycles
         cycles += 160;
@@ -2149,21 +2640,7 @@ void CPU::execute_RRC_89(uint32_t instruction) {
 
 void CPU::execute_RL_90(uint32_t instruction) {
     uint8_t regNum = (instruction >> 8) & 0b111;
-    uint8_t reg = regs[regNum];
-    bool carry = get_flag(C_FLAG_BIT); // Get the carry flag
-
-    // Set flags
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, false);
-    set_flag(C_FLAG_BIT, reg & 0x80); // Set carry if the highest bit is set
-
-    // Rotate left through carry
-    reg = (reg << 1) | carry;
-
-    regs[regNum] = reg;
-
-    // Must set after register updated
-    set_flag(Z_FLAG_BIT, reg == 0);
+    regs[regNum] = shift(SHIFT_RL, regs[regNum]);
 
     pc += 2; // 2-byte instruction
     cycles += 2;
@@ -2171,47 +2648,19 @@ void CPU::execute_RL_90(uint32_t instruction) {
 
 void CPU::execute_RL_91(uint32_t instruction) {
     uint16_t addr = get_hl();
-    uint8_t hl = mmu->read_mem(addr);
-    bool carry = get_flag(C_FLAG_BIT); // Get the carry flag
-
-    // Set flags
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, false);
-    set_flag(C_FLAG_BIT, hl & 0x80); // Set carry if the highest bit is set
-
-    // Rotate left through carry
-    hl = (hl << 1) | carry;
-
-    mmu->write_mem(addr, hl);
+    bus->write_mem(addr, shift(SHIFT_RL, bus->read_mem(addr)));
     if (addr == 0xFF46) {
         // DMA transfer, adjust cycles
         cycles += 160;
     }
 
-    // Must set after register updated
-    set_flag(Z_FLAG_BIT, hl == 0);
-
     pc += 2; // 2-byte instruction
     cycles += 4;
 }
 
 void CPU::execute_RR_92(uint32_t instruction) {
     uint8_t regNum = (instruction >> 8) & 0b111;
-    uint8_t reg = regs[regNum];
-    bool carry = get_flag(C_FLAG_BIT); // Get the carry flag
-
-    // Set flags
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, false);
-    set_flag(C_FLAG_BIT, reg & 0x01); // Set carry if the lowest bit is set
-
-    // Rotate right through carry
-    reg = (reg >> 1) | (carry << 7);
-
-    regs[regNum] = reg;
-
-    // Must set after register updated
-    set_flag(Z_FLAG_BIT, reg == 0);
+    regs[regNum] = shift(SHIFT_RR, regs[regNum]);
 
     pc += 2; // 2-byte instruction
     cycles += 2;
@@ -2219,45 +2668,19 @@ void CPU::execute_RR_92(uint32_t instruction) {
 
 void CPU::execute_RR_93(uint32_t instruction) {
     uint16_t addr = get_hl();
-    uint8_t hl = mmu->read_mem(addr);
-    bool carry = get_flag(C_FLAG_BIT); // Get the carry flag
-
-    // Set flags
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, false);
-    set_flag(C_FLAG_BIT, hl & 0x01); // Set carry if the lowest bit is set
-
-    // Rotate right through carry
-    hl = (hl >> 1) | (carry << 7);
-
-    mmu->write_mem(addr, hl);
+    bus->write_mem(addr, shift(SHIFT_RR, bus->read_mem(addr)));
     if (addr == 0xFF46) {
         // DMA transfer, adjust cycles
         cycles += 160;
     }
 
-    // Must set after register updated
-    set_flag(Z_FLAG_BIT, hl == 0);
-
     pc += 2; // 2-byte instruction
     cycles += 4;
 }
 
 void CPU::execute_SLA_94(uint32_t instruction) {
     uint8_t regNum = (instruction >> 8) & 0b111;
-    uint8_t reg = regs[regNum];
-    bool carry = reg & 0x80; // Check if the highest bit is set
-
-    // Shift left
-    reg <<= 1;
-
-    regs[regNum] = reg;
-
-    // Set flags
-    set_flag(Z_FLAG_BIT, reg == 0);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, false);
-    set_flag(C_FLAG_BIT, carry);
+    regs[regNum] = shift(SHIFT_SLA, regs[regNum]);
 
     pc += 2; // 2-byte instruction
     cycles += 2;
@@ -2265,43 +2688,19 @@ void CPU::execute_SLA_94(uint32_t instruction) {
 
 void CPU::execute_SLA_95(uint32_t instruction) {
     uint16_t addr = get_hl();
-    uint8_t hl = mmu->read_mem(addr);
-    bool carry = hl & 0x80; // Check if the highest bit is set
-
-    // Shift left
-    hl <<= 1;
-
-    mmu->write_mem(addr, hl);
+    bus->write_mem(addr, shift(SHIFT_SLA, bus->read_mem(addr)));
     if (addr == 0xFF46) {
         // DMA transfer, adjust cycles
         cycles += 160;
     }
 
-    // Set flags
-    set_flag(Z_FLAG_BIT, hl == 0);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, false);
-    set_flag(C_FLAG_BIT, carry);
-
     pc += 2; // 2-byte instruction
     cycles += 4;
 }
 
 void CPU::execute_SRA_96(uint32_t instruction) {
     uint8_t regNum = (instruction >> 8) & 0b111;
-    uint8_t reg = regs[regNum];
-    bool carry = reg & 0x01; // Check if the lowest bit is set
-
-    // Shift right (bit 7 remains unchanged)
-    reg = (reg & 0x80) | (reg >> 1);
-
-    regs[regNum] = reg;
-
-    // Set flags
-    set_flag(Z_FLAG_BIT, reg == 0);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, false);
-    set_flag(C_FLAG_BIT, carry);
+    regs[regNum] = shift(SHIFT_SRA, regs[regNum]);
 
     pc += 2; // 2-byte instruction
     cycles += 2;
@@ -2309,113 +2708,53 @@ void CPU::execute_SRA_96(uint32_t instruction) {
 
 void CPU::execute_SRA_97(uint32_t instruction) {
     uint16_t addr = get_hl();
-    uint8_t hl = mmu->read_mem(addr);
-    bool carry = hl & 0x01; // Check if the lowest bit is set
-
-    // Shift right (bit 7 remains unchanged)
-    hl = (hl & 0x80) | (hl >> 1);
-
-    mmu->write_mem(addr, hl);
+    bus->write_mem(addr, shift(SHIFT_SRA, bus->read_mem(addr)));
     if (addr == 0xFF46) {
         // DMA transfer, adjust cycles
         cycles += 160;
     }
 
-    // Set flags
-    set_flag(Z_FLAG_BIT, hl == 0);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, false);
-    set_flag(C_FLAG_BIT, carry);
-
     pc += 2; // 2-byte instruction
     cycles += 4;
 }
 
 // Rishi
 void CPU::execute_SWAP_98(uint32_t instruction) {
-    uint8_t opcode = (instruction >> 8) & 0xFF;
-    uint8_t reg = opcode & 0b00000111;
-
-    // Retrieve value
-    uint8_t cur_data = regs[reg];
-    // Swap nibbles
-    uint8_t new_data = ((cur_data & 0x0F) << 4) | ((cur_data & 0xF0) >> 4);
-    // Store value
-    regs[reg] = new_data;
-
-    // Set flags
-    set_flag(Z_FLAG_BIT, !new_data);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, false);
-    set_flag(C_FLAG_BIT, false);
+    uint8_t regNum = (instruction >> 8) & 0b111;
+    regs[regNum] = shift(SHIFT_SWAP, regs[regNum]);
 
     pc += 2; // 2-byte instruction
     cycles += 2;
 }
 
 void CPU::execute_SWAP_99(uint32_t instruction) {
-    // Retrieve value
-    uint8_t cur_data = (*mmu).read_mem(get_hl());
-    // Swap nibbles
-    uint8_t new_data = ((cur_data & 0x0F) << 4) | ((cur_data & 0xF0) >> 4);
     uint16_t addr = get_hl();
-    // Store value
-    (*mmu).write_mem(addr, new_data);
+    bus->write_mem(addr, shift(SHIFT_SWAP, bus->read_mem(addr)));
     if (addr == 0xFF46) {
         // DMA transfer, adjust cycles
         cycles += 160;
     }
 
-    // Set flags
-    set_flag(Z_FLAG_BIT, !new_data);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, false);
-    set_flag(C_FLAG_BIT, false);
-
     pc += 2; // 2-byte instruction
     cycles += 4;
 }
 
 void CPU::execute_SRL_100(uint32_t instruction) {
-    uint8_t opcode = (instruction >> 8) & 0xFF;
-    uint8_t reg = opcode & 0b00000111;
-
-    // Retrieve value
-    uint8_t cur_data = regs[reg];
-    // Shift right
-    uint8_t new_data = cur_data >> 1;
-    // Store value
-    regs[reg] = new_data;
-
-    // Set flags
-    set_flag(Z_FLAG_BIT, !new_data);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, false);
-    set_flag(C_FLAG_BIT, cur_data & 1);
+    uint8_t regNum = (instruction >> 8) & 0b111;
+    regs[regNum] = shift(SHIFT_SRL, regs[regNum]);
 
     pc += 2; // 2-byte instruction
     cycles += 2;
 }
 
 void CPU::execute_SRL_101(uint32_t instruction) {
-    // Retrieve value
-    uint8_t cur_data = (*mmu).read_mem(get_hl());
-    // Shift right
-    uint8_t new_data = cur_data >> 1;
     uint16_t addr = get_hl();
-    // Store value
-    (*mmu).write_mem(addr, new_data);
+    bus->write_mem(addr, shift(SHIFT_SRL, bus->read_mem(addr)));
     if (addr == 0xFF46) {
         // DMA transfer, adjust cycles
         cycles += 160;
     }
 
-    // Set flags
-    set_flag(Z_FLAG_BIT, !new_data);
-    set_flag(N_FLAG_BIT, false);
-    set_flag(H_FLAG_BIT, false);
-    set_flag(C_FLAG_BIT, cur_data & 1);
-
     pc += 2; // 2-byte instruction
     cycles += 4;
 }
@@ -2444,7 +2783,7 @@ void CPU::execute_BIT_103(uint32_t instruction) {
     uint8_t bit = (opcode >> 3) & 0b00000111;
     
     // Retrieve value
-    uint8_t cur_data = (*mmu).read_mem(get_hl());
+    uint8_t cur_data = bus->read_mem(get_hl());
     // Check bit
     bool val = (cur_data >> bit) & 1;
 
@@ -2478,12 +2817,12 @@ void CPU::execute_RES_105(uint32_t instruction) {
     uint8_t bit = (opcode >> 3) & 0b00000111;
 
     // Retrieve value
-    uint8_t cur_data = (*mmu).read_mem(get_hl());
+    uint8_t cur_data = bus->read_mem(get_hl());
     // Clear bit
     uint8_t new_data = cur_data & ~(1 << bit);
 	uint16_t addr = get_hl();
     // Store value
-    (*mmu).write_mem(addr, new_data);
+    bus->write_mem(addr, new_data);
     if (addr == 0xFF46) {
         // DMA transfer, adjust cycles
         cycles += 160;
@@ -2514,12 +2853,12 @@ void CPU::execute_SET_107(uint32_t instruction) {
     uint8_t bit = (opcode >> 3) & 0b00000111;
 
     // Retrieve value
-    uint8_t cur_data = (*mmu).read_mem(get_hl());
+    uint8_t cur_data = bus->read_mem(get_hl());
     // Set bit
     uint8_t new_data = cur_data | (1 << bit);
 	uint16_t addr = get_hl();
     // Store value
-    (*mmu).write_mem(addr, new_data);
+    bus->write_mem(addr, new_data);
     if (addr == 0xFF46) {
         // DMA transfer, adjust cycles
         cycles += 160;
@@ -2651,7 +2990,7 @@ void CPU::execute_CALL_116(uint32_t instruction) {
     uint16_t call_addr = static_cast<uint16_t>(msb << 8) | lsb;
 
     // Push current PC onto stack
-    mmu->push_stack(sp, pc + 3); // 3-byte instruction
+    bus->push_stack(sp, pc + 3); // 3-byte instruction
     sp -= 2;
 
     pc = call_addr;
@@ -2689,7 +3028,7 @@ void CPU::execute_CALL_117(uint32_t instruction) {
         uint16_t call_addr = static_cast<uint16_t>(msb << 8) | lsb;
 
         // Push current PC onto stack
-        mmu->push_stack(sp, pc + 3); // 3-byte instruction
+        bus->push_stack(sp, pc + 3); // 3-byte instruction
         sp -= 2;
 
         pc = call_addr;
@@ -2702,7 +3041,7 @@ void CPU::execute_CALL_117(uint32_t instruction) {
 
 void CPU::execute_RET_119(uint32_t instruction) {
     // Pop address from stack
-    uint16_t ret_addr = mmu->pop_stack(sp);
+    uint16_t ret_addr = bus->pop_stack(sp);
     sp += 2;
 
     pc = ret_addr; // Unconditional return
@@ -2734,7 +3073,7 @@ void CPU::execute_RET_120(uint32_t instruction) {
 
     if (condition_met) {
         // Pop address from stack
-        uint16_t ret_addr = mmu->pop_stack(sp);
+        uint16_t ret_addr = bus->pop_stack(sp);
         sp += 2;
 
         pc = ret_addr;
@@ -2747,10 +3086,11 @@ void CPU::execute_RET_120(uint32_t instruction) {
 
 void CPU::execute_RETI_121(uint32_t instruction) {
     // Pop address from stack
-    uint16_t ret_addr = mmu->pop_stack(sp);
+    uint16_t ret_addr = bus->pop_stack(sp);
     sp += 2;
 
     ime = true; // Enable interrupts
+    limit_run(0);
 
     pc = ret_addr; // Unconditional return
     cycles += 4;
@@ -2761,7 +3101,7 @@ void CPU::execute_RST_122(uint32_t instruction) {
     uint8_t addr = (opcode >> 3) & 0b00000111;
 
     // Push current PC onto stack
-    mmu->push_stack(sp, pc + 1); // 1-byte instruction
+    bus->push_stack(sp, pc + 1); // 1-byte instruction
     sp -= 2;
 
     // Jump based on addr
@@ -2803,6 +3143,7 @@ void CPU::execute_RST_122(uint32_t instruction) {
 
 void CPU::execute_HALT_123(uint32_t instruction) {
     halted = true;
+    limit_run(0); // run() fast-forwards from here
 
     pc += 1; // 1-byte instruction
     cycles += 2;
@@ -2824,6 +3165,7 @@ void CPU::execute_DI_123(uint32_t instruction) {
 
 void CPU::execute_EI_124(uint32_t instruction) {
     ime = true; // Enable interrupts
+    limit_run(0);
 
     pc += 1; // 1-byte instruction
     cycles += 1;
@@ -0,0 +1,142 @@
+#include "../include/emulator.hpp"
+#include <iostream>
+#include <fstream>
+#include <vector>
+
+//#define ENABLE_BOOT
+
+Emulator::Emulator() : frames(0) {
+    scheduler.connect_cpu(&cpu);
+    bus.connect_input(&input);
+    bus.connect_timer(&timer);
+    bus.connect_scheduler(&scheduler);
+    ppu.connect_bus(&bus);
+    ppu.connect_interrupt_handler(&IH);
+    cpu.connect_bus(&bus);
+    cpu.connect_interrupt_handler(&IH);
+    cpu.connect_block_cache(&block_cache);
+    bus.connect_block_cache(&block_cache);
+#ifdef ENABLE_JIT
+    cpu.connect_jit(&jit);
+#endif
+#ifdef ENABLE_PROFILER
+    cpu.connect_profiler(&profiler);
+#endif
+    bus.connect_interrupt_handler(&IH);
+    timer.connect_interrupt_handler(&IH);
+    timer.connect_scheduler(&scheduler);
+    ppu.connect_scheduler(&scheduler);
+    scheduler.schedule(EVENT_FRAME, PPU::FRAME_CYCLES);
+}
+
+bool Emulator::load_file(const std::string &path) {
+    // Open the ROM file in binary mode, positioned at the end
+    std::ifstream rom_file(path, std::ios::binary | std::ios::ate);
+
+    if (!rom_file.is_open()) {
+        std::cerr << "Error: Failed to open ROM file: " << path << std::endl;
+        return false;
+    }
+
+    // Get the size of the file
+    std::streamsize size = rom_file.tellg();
+    rom_file.seekg(0, std::ios::beg); // Go back to the beginning
+
+    if (size == 0) {
+        std::cerr << "file is empty: " << path << std::endl;
+        return false;
+    }
+
+    std::cout << "Loading ROM: " << path << " (" << size << " bytes)" << std::endl;
+
+    // Read the ROM data into a buffer
+    std::vector<char> buffer(size);
+    if (!rom_file.read(buffer.data(), size)) {
+        std::cerr << "Error: Failed to read ROM file: " << path << std::endl;
+        return false;
+    }
+
+    // Limit loading to 32KB for now. Nothing has been decoded yet, so the
+    // raw writes need no code invalidation.
+    size_t load_size = std::min((size_t)size, (size_t)0x8000);
+    for (size_t i = 0; i < load_size; ++i) {
+        bus.write_raw(static_cast<uint16_t>(i), static_cast<uint8_t>(buffer[i]));
+    }
+
+    std::cout << "Loaded " << load_size << " bytes into memory." << std::endl;
+    return true;
+}
+
+bool Emulator::load_rom(const std::string &rom_path) {
+    if (!load_file(rom_path)) {
+        return false;
+    }
+#ifdef ENABLE_BOOT
+    if (!load_file("boot.bin")) {
+        return false;
+    }
+#endif // ENABLE_BOOT
+    return true;
+}
+
+uint32_t Emulator::service_events() {
+    uint32_t happened = 0;
+    Event event;
+    while (scheduler.pop_due(cpu.get_cycles(), event)) {
+        switch (event.type) {
+            case EVENT_PPU:
+                if (ppu.handle_event(event.time)) {
+                    frames++;
+                    happened |= EMU_VBLANK;
+                }
+                break;
+            case EVENT_TIMER:
+                timer.handle_event(event.time);
+                break;
+            case EVENT_DMA:
+                bus.dma_transfer();
+                break;
+            case EVENT_FRAME:
+                happened |= EMU_HOST_FRAME;
+                scheduler.schedule(EVENT_FRAME, event.time + PPU::FRAME_CYCLES);
+                break;
+            default:
+                break;
+        }
+    }
+    return happened;
+}
+
+bool Emulator::run_cpu() {
+    cpu.handle_interrupts();
+
+    // Run up to the next event (replayed from the block cache when the PC
+    // is in cached code). The CPU returns early when an interrupt may have
+    // become pending.
+    uint64_t target = scheduler.next_time();
+    return cpu.run(target);
+}
+
+#ifdef ENABLE_TRACE
+bool Emulator::start_trace(const std::string &path) {
+    if (!tracer.start(path)) {
+        return false;
+    }
+    cpu.connect_tracer(&tracer);
+    bus.connect_tracer(&tracer);
+    return true;
+}
+
+void Emulator::stop_trace() {
+    cpu.connect_tracer(nullptr);
+    bus.connect_tracer(nullptr);
+    tracer.stop();
+}
+#endif
+
+std::string Emulator::find_rom(const std::string &name) {
+    if (std::ifstream(name, std::ios::binary).is_open()) {
+        return name;
+    }
+    return "./games/" + name;
+}
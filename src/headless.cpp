@@ -0,0 +1,151 @@
+/**
+ * Headless frontend: runs a ROM with no window, input or frame pacing for
+ * a number of frames or M-cycles, then prints run statistics and can write
+ * the last complete frame out as a PPM image. Links against the core only,
+ * no SDL.
+ *
+ * Usage: gheithboy-headless [--frames N] [--cycles N] [--dump file.ppm] [--trace file] <rom>
+ *   --frames N    stop after N frames (default 600, ten emulated seconds)
+ *   --cycles N    stop once N M-cycles have run (overrides --frames)
+ *   --dump FILE   write the final framebuffer as a binary PPM
+ *   --trace FILE  write a binary execution trace (ENABLE_TRACE builds only;
+ *                 print it with trace_decode)
+ * The ROM is a path, or a file name under ./games/.
+ */
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "../include/emulator.hpp"
+
+// M-cycles per second of the real hardware
+static const double CYCLES_PER_SECOND = 1048576.0;
+
+static void usage(const char *name) {
+    std::cerr << "Usage: " << name << " [--frames N] [--cycles N] [--dump file.ppm] [--trace file] <rom>\n";
+}
+
+static bool write_ppm(const std::string &path, const PPU &ppu) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out.is_open()) {
+        std::cerr << "Error: Failed to open " << path << " for writing" << std::endl;
+        return false;
+    }
+    const int width = sizeof(ppu.pixelsToRender[0]) / sizeof(ppu.pixelsToRender[0][0]);
+    const int height = sizeof(ppu.pixelsToRender) / sizeof(ppu.pixelsToRender[0]);
+    out << "P6\n" << width << " " << height << "\n255\n";
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint32_t pixel = ppu.pixelsToRender[y][x]; // 0xAARRGGBB
+            out.put(static_cast<char>((pixel >> 16) & 0xFF));
+            out.put(static_cast<char>((pixel >> 8) & 0xFF));
+            out.put(static_cast<char>(pixel & 0xFF));
+        }
+    }
+    return static_cast<bool>(out);
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t max_frames = 600;
+    uint64_t max_cycles = 0; // 0: run by frames
+    std::string dump_path;
+    std::string trace_path;
+    std::string rom_name;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--frames" || arg == "--cycles" || arg == "--dump" || arg == "--trace") && i + 1 < argc) {
+            std::string value = argv[++i];
+            if (arg == "--dump") {
+                dump_path = value;
+            } else if (arg == "--trace") {
+                trace_path = value;
+            } else if (arg == "--frames") {
+                max_frames = std::stoull(value);
+            } else {
+                max_cycles = std::stoull(value);
+            }
+        } else if (rom_name.empty() && arg[0] != '-') {
+            rom_name = arg;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (rom_name.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::string rom_path = Emulator::find_rom(rom_name);
+    Emulator *emu = new Emulator();
+    if (!emu->load_rom(rom_path)) {
+        delete emu;
+        return 1;
+    }
+    if (!trace_path.empty()) {
+#ifdef ENABLE_TRACE
+        if (!emu->start_trace(trace_path)) {
+            delete emu;
+            return 1;
+        }
+#else
+        std::cerr << "Error: --trace needs a build with ENABLE_TRACE (make TRACE=1)" << std::endl;
+        delete emu;
+        return 1;
+#endif
+    }
+
+    bool ok = true;
+    auto start = std::chrono::steady_clock::now();
+    while (true) {
+        emu->service_events();
+        if (max_cycles ? emu->cpu.get_cycles() >= max_cycles : emu->frames >= max_frames) {
+            break;
+        }
+        if (!emu->run_cpu()) {
+            std::cerr << "Unknown instruction: " << std::hex << emu->cpu.fetch_instruction() << std::dec
+                      << std::endl;
+            ok = false;
+            break;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+#ifdef ENABLE_TRACE
+    emu->stop_trace();
+#endif
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    uint64_t cycles = emu->cpu.get_cycles();
+    std::cout << "rom:                 " << rom_path << "\n"
+              << "frames:              " << emu->frames << "\n"
+              << "M-cycles:            " << cycles << "\n"
+              << "host seconds:        " << seconds << "\n"
+              << "M-cycles/s:          " << (seconds > 0 ? cycles / seconds : 0.0) << "\n"
+              << "speed:               " << (seconds > 0 ? cycles / CYCLES_PER_SECOND / seconds : 0.0)
+              << "x real time\n"
+              << "idle cycles skipped: " << emu->cpu.idle_cycles_skipped << " ("
+              << (cycles ? 100.0 * emu->cpu.idle_cycles_skipped / cycles : 0.0) << "%)\n"
+              << "blocks decoded:      " << emu->block_cache.blocks_decoded << "\n"
+              << "blocks invalidated:  " << emu->block_cache.blocks_invalidated << "\n";
+#ifdef ENABLE_JIT
+    std::cout << "blocks compiled:     " << emu->jit.blocks_compiled << "\n"
+              << "native runs:         " << emu->jit.native_runs << "\n";
+#endif
+#ifdef ENABLE_TRACE
+    std::cout << "instructions traced: " << emu->tracer.records << "\n"
+              << "trace writer stalls: " << emu->tracer.stalls << "\n";
+#endif
+#ifdef ENABLE_PROFILER
+    std::cout << "\n";
+    emu->profiler.report(std::cout, emu->cpu);
+#endif
+
+    if (!dump_path.empty() && !write_ppm(dump_path, emu->ppu)) {
+        ok = false;
+    }
+    delete emu;
+    return ok ? 0 : 1;
+}
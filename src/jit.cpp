@@ -0,0 +1,946 @@
+#include "../include/jit.hpp"
+
+#ifdef ENABLE_JIT
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <string.h>
+#include <iostream>
+
+#include "../include/cpu.hpp"
+#include "../include/bus.hpp"
+
+// Calls from generated code into the interpreter: one plain function per
+// execute_* handler, so the call site needs no member-pointer ABI
+template <void (CPU::*Handler)(uint32_t)>
+static void jit_thunk(CPU *cpu, uint32_t instruction) {
+    (cpu->*Handler)(instruction);
+}
+
+#define JIT_THUNK(mnemonic, number) &jit_thunk<&CPU::execute_##mnemonic##_##number>,
+static void (*const jit_thunks[HANDLER_COUNT])(CPU *cpu, uint32_t instruction) = {
+    CPU_INSTRUCTION_LIST(JIT_THUNK)
+};
+#undef JIT_THUNK
+
+// x86-64 registers by encoding. Generated code keeps
+//   rbx  the CPU          rbp  the Bus
+//   r12  cpu->cycles     r15  cpu->run_target
+//   r13  &generation     r14d generation on entry
+// and uses eax, ecx, edx and esi as scratch. cycles is written back before
+// every call out and reloaded after it together with run_target, which
+// the bus or a handler may have lowered.
+static const uint8_t EAX = 0;
+static const uint8_t ECX = 1;
+static const uint8_t EDX = 2;
+static const uint8_t ESI = 6;
+static const uint8_t R12 = 12;
+static const uint8_t R15 = 15;
+
+// Opcodes of the 32-bit register-to-register forms (op r/m32, r32)
+static const uint8_t OP_ADD = 0x01;
+static const uint8_t OP_OR = 0x09;
+static const uint8_t OP_AND = 0x21;
+static const uint8_t OP_SUB = 0x29;
+static const uint8_t OP_XOR = 0x31;
+static const uint8_t OP_MOV = 0x89;
+
+// Condition codes: short jumps are 0x7x, near jumps 0x0F 0x8x
+static const uint8_t JCC_E = 0x04;
+static const uint8_t JCC_NE = 0x05;
+static const uint8_t JCC_AE = 0x03;
+static const uint8_t JCC_B = 0x02;
+
+// Operations of emit_alu(), in the order of the opcode's bits 3-5
+enum AluOperation { ALU_ADD, ALU_ADC, ALU_SUB, ALU_SBC, ALU_AND, ALU_XOR, ALU_OR, ALU_CP };
+
+Jit::Jit(size_t arena_size) {
+    this->arena_size = arena_size;
+    arena_used = 0;
+    arena_executable = true;
+    regs_offset = -1;
+    wrote_memory = false;
+    stored_pc = false;
+    differential = false;
+    blocks_compiled = 0;
+    native_runs = 0;
+    mismatches = 0;
+    bus_before = new Bus();
+    bus_native = new Bus();
+
+    void *mapping = mmap(nullptr, arena_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    arena = (mapping == MAP_FAILED) ? nullptr : static_cast<uint8_t *>(mapping);
+    if (!arena) {
+        std::cerr << "JIT Warning: could not map the code arena, blocks will be interpreted" << std::endl;
+    }
+}
+
+Jit::~Jit() {
+    if (arena) {
+        munmap(arena, arena_size);
+    }
+    delete bus_before;
+    delete bus_native;
+}
+
+static int32_t field_offset(const void *base, const void *field) {
+    return static_cast<int32_t>(static_cast<const char *>(field) - static_cast<const char *>(base));
+}
+
+void Jit::find_offsets(CPU *cpu) {
+    regs_offset = field_offset(cpu, &cpu->regs[0]);
+    pc_offset = field_offset(cpu, &cpu->pc);
+    sp_offset = field_offset(cpu, &cpu->sp);
+    cycles_offset = field_offset(cpu, &cpu->cycles);
+    run_target_offset = field_offset(cpu, &cpu->run_target);
+    flag_result_offset = field_offset(cpu, &cpu->flag_result);
+    flag_half_offset = field_offset(cpu, &cpu->flag_half);
+    flag_n_offset = field_offset(cpu, &cpu->flag_n);
+    flag_c_offset = field_offset(cpu, &cpu->flag_c);
+    ime_offset = field_offset(cpu, &cpu->ime);
+    bus_offset = field_offset(cpu, &cpu->bus);
+
+    Bus *bus = cpu->bus;
+    read_pages_offset = field_offset(bus, &bus->read_pages[0]);
+    write_pages_offset = field_offset(bus, &bus->write_pages[0]);
+    mem_offset = field_offset(bus, &bus->mem[0]);
+}
+
+uint8_t Jit::read_slow(Bus *bus, uint16_t addr) {
+    return bus->read_mem(addr);
+}
+
+// The tail of the store handlers: the OAM DMA they start stalls the CPU
+void Jit::write_slow(CPU *cpu, uint16_t addr, uint8_t data) {
+    cpu->bus->write_mem(addr, data);
+    if (addr == 0xFF46) {
+        cpu->cycles += 160;
+    }
+}
+
+uint16_t Jit::pop_slow(Bus *bus, uint16_t sp) {
+    return bus->pop_stack(sp);
+}
+
+void Jit::emit16(uint16_t value) {
+    emit8(static_cast<uint8_t>(value));
+    emit8(static_cast<uint8_t>(value >> 8));
+}
+
+void Jit::emit32(uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        emit8(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+void Jit::emit64(uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        emit8(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+void Jit::emit_mem_rbx(uint8_t reg_field, int32_t disp) {
+    emit8(0x80 | (reg_field << 3) | 0x03); // mod=10 (disp32), rm=rbx
+    emit32(static_cast<uint32_t>(disp));
+}
+
+// [rex] opcode ModRM with reg and [rbx + disp]. rex is 0x48 for 64-bit
+// operands or 0; REX.R is added for r8-r15.
+void Jit::emit_rbx(uint8_t rex, std::initializer_list<uint8_t> opcode, uint8_t reg, int32_t disp) {
+    if (reg & 8) {
+        rex |= 0x44;
+    }
+    if (rex) {
+        emit8(rex);
+    }
+    for (uint8_t byte : opcode) {
+        emit8(byte);
+    }
+    emit_mem_rbx(reg & 7, disp);
+}
+
+void Jit::emit_rr(uint8_t opcode, uint8_t dst, uint8_t src) {
+    emit8(opcode);
+    emit8(0xC0 | (src << 3) | dst);
+}
+
+// Short forward jump; bind8() points it at the current position
+size_t Jit::emit_jump8(uint8_t opcode) {
+    emit8(opcode);
+    emit8(0);
+    return code.size() - 1;
+}
+
+void Jit::bind8(size_t pos) {
+    code[pos] = static_cast<uint8_t>(code.size() - (pos + 1));
+}
+
+// Forward jcc with a 32-bit displacement, for jumps over a call out
+size_t Jit::emit_jump32(uint8_t jcc) {
+    emit8(0x0F);
+    emit8(0x80 | jcc);
+    emit32(0);
+    return code.size() - 4;
+}
+
+void Jit::bind32(size_t pos) {
+    uint32_t rel = static_cast<uint32_t>(code.size() - (pos + 4));
+    memcpy(&code[pos], &rel, sizeof(rel));
+}
+
+// jcc to the exit taken after executed instructions (placed by compile())
+void Jit::emit_exit(uint8_t jcc, uint32_t executed) {
+    emit8(0x0F);
+    emit8(0x80 | jcc);
+    exits.push_back({code.size(), executed});
+    emit32(0);
+}
+
+// Call out with cycles written back, then reload it and the run target
+void Jit::emit_call(const void *function) {
+    emit_rbx(0x48, {0x89}, R12, cycles_offset);     // mov [rbx+cycles], r12
+    emit8(0x48); emit8(0xB8);                       // mov rax, function
+    emit64(reinterpret_cast<uint64_t>(function));
+    emit8(0xFF); emit8(0xD0);                       // call rax
+    emit_rbx(0x48, {0x8B}, R12, cycles_offset);     // mov r12, [rbx+cycles]
+    emit_rbx(0x48, {0x8B}, R15, run_target_offset); // mov r15, [rbx+run_target]
+}
+
+// Bus::read_mem: the page table and HRAM inline, read_mem_slow out of line
+void Jit::emit_read() {
+    emit_rr(OP_MOV, EDX, ECX);                      // mov edx, ecx
+    emit8(0xC1); emit8(0xEA); emit8(8);             // shr edx, 8
+    emit8(0x48); emit8(0x8B); emit8(0x94); emit8(0xD5); // mov rdx, [rbp + rdx*8 + read_pages]
+    emit32(static_cast<uint32_t>(read_pages_offset));
+    emit8(0x48); emit8(0x85); emit8(0xD2);          // test rdx, rdx
+    size_t slow = emit_jump8(0x70 | JCC_E);
+    emit8(0x0F); emit8(0xB6); emit8(0xF1);          // movzx esi, cl
+    emit8(0x0F); emit8(0xB6); emit8(0x04); emit8(0x32); // movzx eax, byte [rdx + rsi]
+    size_t done = emit_jump8(0xEB);
+
+    bind8(slow);
+    emit8(0x8D); emit8(0x91); emit32(static_cast<uint32_t>(-0xFF80)); // lea edx, [rcx - 0xFF80]
+    emit8(0x83); emit8(0xFA); emit8(0x7F);          // cmp edx, 0x7F (0xFFFF is IE)
+    size_t not_hram = emit_jump8(0x70 | JCC_AE);
+    emit8(0x0F); emit8(0xB6); emit8(0x84); emit8(0x0D); // movzx eax, byte [rbp + rcx + mem]
+    emit32(static_cast<uint32_t>(mem_offset));
+    size_t hram_done = emit_jump8(0xEB);
+
+    bind8(not_hram);
+    emit8(0x48); emit8(0x89); emit8(0xEF);          // mov rdi, rbp
+    emit_rr(OP_MOV, ESI, ECX);                      // mov esi, ecx
+    emit_call(reinterpret_cast<const void *>(&Jit::read_slow));
+    emit8(0x0F); emit8(0xB6); emit8(0xC0);          // movzx eax, al
+    bind8(done);
+    bind8(hram_done);
+}
+
+// Bus::write_mem: direct pages inline, except tile data (the tile cache
+// has to hear about it) and everything write_mem_slow handles, which can
+// invalidate cached code
+void Jit::emit_write() {
+    emit_rr(OP_MOV, EDX, ECX);                      // mov edx, ecx
+    emit8(0xC1); emit8(0xEA); emit8(8);             // shr edx, 8
+    emit8(0x48); emit8(0x8B); emit8(0x94); emit8(0xD5); // mov rdx, [rbp + rdx*8 + write_pages]
+    emit32(static_cast<uint32_t>(write_pages_offset));
+    emit8(0x48); emit8(0x85); emit8(0xD2);          // test rdx, rdx
+    size_t slow = emit_jump8(0x70 | JCC_E);
+    emit8(0x8D); emit8(0xB1);                       // lea esi, [rcx - TILE_DATA_START]
+    emit32(static_cast<uint32_t>(-static_cast<int32_t>(TileCache::TILE_DATA_START)));
+    emit8(0x81); emit8(0xFE);                       // cmp esi, tile data size
+    emit32(TileCache::TILE_DATA_END - TileCache::TILE_DATA_START);
+    size_t tile = emit_jump8(0x70 | JCC_B);
+    emit8(0x0F); emit8(0xB6); emit8(0xF1);          // movzx esi, cl
+    emit8(0x88); emit8(0x04); emit8(0x32);          // mov [rdx + rsi], al
+    size_t done = emit_jump8(0xEB);
+
+    bind8(slow);
+    bind8(tile);
+    emit8(0x48); emit8(0x89); emit8(0xDF);          // mov rdi, rbx
+    emit_rr(OP_MOV, ESI, ECX);                      // mov esi, ecx
+    emit_rr(OP_MOV, EDX, EAX);                      // mov edx, eax
+    emit_call(reinterpret_cast<const void *>(&Jit::write_slow));
+    bind8(done);
+    wrote_memory = true;
+}
+
+// Bus::pop_stack: both bytes at once when they are on one direct page or
+// in HRAM, pop_slow (read_mem twice) otherwise
+void Jit::emit_pop() {
+    emit_rbx(0, {0x0F, 0xB7}, ECX, sp_offset);      // movzx ecx, word [rbx+sp]
+    emit_rr(OP_MOV, EDX, ECX);                      // mov edx, ecx
+    emit8(0xC1); emit8(0xEA); emit8(8);             // shr edx, 8
+    emit8(0x48); emit8(0x8B); emit8(0x94); emit8(0xD5); // mov rdx, [rbp + rdx*8 + read_pages]
+    emit32(static_cast<uint32_t>(read_pages_offset));
+    emit8(0x48); emit8(0x85); emit8(0xD2);          // test rdx, rdx
+    size_t not_direct = emit_jump8(0x70 | JCC_E);
+    emit8(0x80); emit8(0xF9); emit8(0xFF);          // cmp cl, 0xFF (SP + 1 on the next page)
+    size_t crosses = emit_jump8(0x70 | JCC_E);
+    emit8(0x0F); emit8(0xB6); emit8(0xF1);          // movzx esi, cl
+    emit8(0x0F); emit8(0xB7); emit8(0x04); emit8(0x32); // movzx eax, word [rdx + rsi]
+    size_t direct_done = emit_jump8(0xEB);
+
+    bind8(not_direct);
+    emit8(0x8D); emit8(0x91); emit32(static_cast<uint32_t>(-0xFF80)); // lea edx, [rcx - 0xFF80]
+    emit8(0x83); emit8(0xFA); emit8(0x7E);          // cmp edx, 0x7E (both bytes below IE)
+    size_t not_hram = emit_jump8(0x70 | JCC_AE);
+    emit8(0x0F); emit8(0xB7); emit8(0x84); emit8(0x0D); // movzx eax, word [rbp + rcx + mem]
+    emit32(static_cast<uint32_t>(mem_offset));
+    size_t hram_done = emit_jump8(0xEB);
+
+    bind8(crosses);
+    bind8(not_hram);
+    emit8(0x48); emit8(0x89); emit8(0xEF);          // mov rdi, rbp
+    emit_rr(OP_MOV, ESI, ECX);                      // mov esi, ecx
+    emit_call(reinterpret_cast<const void *>(&Jit::pop_slow));
+    emit8(0x0F); emit8(0xB7); emit8(0xC0);          // movzx eax, ax
+    bind8(direct_done);
+    bind8(hram_done);
+    emit8(0x66); emit_rbx(0, {0x83}, 0, sp_offset); // add word [rbx+sp], 2
+    emit8(2);
+}
+
+// reg = BC, DE, HL (pair 0-2, stored high byte first) or SP (pair 3)
+void Jit::emit_load_pair(uint8_t reg, uint8_t pair) {
+    if (pair == 3) {
+        emit_rbx(0, {0x0F, 0xB7}, reg, sp_offset); // movzx reg, word [rbx+sp]
+        return;
+    }
+    emit_rbx(0, {0x0F, 0xB7}, reg, regs_offset + 2 * pair);
+    emit8(0x66); emit8(0xC1); emit8(0xC0 | reg); emit8(8); // rol reg16, 8
+}
+
+// The pair = reg; reg is left byte-swapped for BC, DE and HL
+void Jit::emit_store_pair(uint8_t reg, uint8_t pair) {
+    if (pair == 3) {
+        emit8(0x66); emit_rbx(0, {0x89}, reg, sp_offset); // mov word [rbx+sp], reg16
+        return;
+    }
+    emit8(0x66); emit8(0xC1); emit8(0xC0 | reg); emit8(8);
+    emit8(0x66); emit_rbx(0, {0x89}, reg, regs_offset + 2 * pair);
+}
+
+// INC rr / DEC rr through edx
+void Jit::emit_step_pair(uint8_t pair, bool dec) {
+    emit_load_pair(EDX, pair);
+    emit8(0x66); emit8(0xFF); emit8(dec ? 0xCA : 0xC2); // dec / inc dx
+    emit_store_pair(EDX, pair);
+}
+
+// cc in bits 3-4 of the opcode: NZ, Z, NC, C. Compares the flag piece
+// with 0 and returns the condition code of a jump taken when cc fails.
+uint8_t Jit::emit_condition(uint8_t opcode) {
+    uint8_t condition = (opcode >> 3) & 0x03;
+    int32_t flag = (condition < 2) ? flag_result_offset : flag_c_offset;
+    emit_rbx(0, {0x80}, 7, flag);                   // cmp byte [rbx+flag], 0
+    emit8(0);
+    // Z is set when flag_result is 0, C when flag_c is not
+    return (condition == 0 || condition == 3) ? JCC_E : JCC_NE;
+}
+
+// Jumps end the block: pc is stored here, and the not-taken timing is
+// the decoded base cycles
+void Jit::emit_branch(const DecodedInstruction &op, bool conditional, uint16_t target,
+                      uint8_t taken_cycles) {
+    stored_pc = true;
+    size_t not_taken = 0;
+    if (conditional) {
+        not_taken = emit_jump8(0x70 | emit_condition((op.instruction >> 16) & 0xFF));
+    }
+    emit8(0x66); emit_rbx(0, {0xC7}, 0, pc_offset); // mov word [rbx+pc], target
+    emit16(target);
+    emit8(0x49); emit8(0x83); emit8(0xC4);          // add r12, taken_cycles
+    emit8(taken_cycles);
+    if (target == loop_pc) {
+        // Back to the start of the block: go round again unless the block
+        // was overwritten or the budget is used up
+        emit8(0x45); emit8(0x39); emit8(0x75); emit8(0x00); // cmp [r13], r14d
+        emit8(0x0F); emit8(0x80 | JCC_NE);
+        finish_jumps.push_back(code.size());
+        emit32(0);
+        emit8(0x4D); emit8(0x39); emit8(0xFC);      // cmp r12, r15
+        emit8(0x0F); emit8(0x80 | JCC_AE);
+        finish_jumps.push_back(code.size());
+        emit32(0);
+        emit8(0xFF); emit8(0x04); emit8(0x24);      // inc dword [rsp] (passes)
+        emit8(0xE9);                                // jmp loop_start
+        emit32(static_cast<uint32_t>(loop_start - (code.size() + 4)));
+    }
+    if (conditional) {
+        size_t done = emit_jump8(0xEB);
+        bind8(not_taken);
+        emit8(0x66); emit_rbx(0, {0xC7}, 0, pc_offset); // mov word [rbx+pc], next
+        emit16(static_cast<uint16_t>(op.pc + op.length));
+        emit8(0x49); emit8(0x83); emit8(0xC4);      // add r12, base cycles
+        emit8(op.cycles);
+        bind8(done);
+    }
+}
+
+// A op operand, with the lazy flags the matching handlers set. The
+// result is worked out in 32 bits: bit 4 of a ^ operand ^ result is the
+// half carry and bit 8 the carry (or borrow) of the add or subtract.
+void Jit::emit_alu(uint8_t operation) {
+    int32_t a = regs_offset + A_REGISTER;
+    emit_rbx(0, {0x0F, 0xB6}, EAX, a);              // movzx eax, byte [rbx+A]
+
+    if (operation == ALU_AND || operation == ALU_XOR || operation == ALU_OR) {
+        uint8_t opcode = (operation == ALU_AND) ? OP_AND : (operation == ALU_XOR) ? OP_XOR : OP_OR;
+        emit_rr(opcode, EAX, ECX);
+        emit_rbx(0, {0x88}, EAX, a);                // mov [rbx+A], al
+        emit_rbx(0, {0x88}, EAX, flag_result_offset);
+        emit_rbx(0, {0xC6}, 0, flag_n_offset);      // mov byte [rbx+flag_n], 0
+        emit8(0);
+        emit_rbx(0, {0xC6}, 0, flag_half_offset);
+        emit8(operation == ALU_AND ? 0x10 : 0x00);
+        emit_rbx(0, {0xC6}, 0, flag_c_offset);
+        emit8(0);
+        return;
+    }
+
+    bool subtract = (operation == ALU_SUB || operation == ALU_SBC || operation == ALU_CP);
+    emit_rr(OP_MOV, EDX, EAX);                      // mov edx, eax
+    emit_rr(subtract ? OP_SUB : OP_ADD, EDX, ECX);  // add/sub edx, ecx
+    if (operation == ALU_ADC || operation == ALU_SBC) {
+        emit_rbx(0, {0x0F, 0xB6}, ESI, flag_c_offset); // movzx esi, byte [rbx+flag_c]
+        emit_rr(subtract ? OP_SUB : OP_ADD, EDX, ESI);
+    }
+    if (operation != ALU_CP) {
+        emit_rbx(0, {0x88}, EDX, a);                // mov [rbx+A], dl
+    }
+    emit_rbx(0, {0x88}, EDX, flag_result_offset);   // mov [rbx+flag_result], dl
+    emit_rbx(0, {0xC6}, 0, flag_n_offset);          // mov byte [rbx+flag_n], subtract
+    emit8(subtract ? 1 : 0);
+    emit_rr(OP_XOR, EAX, ECX);                      // xor eax, ecx
+    emit_rr(OP_XOR, EAX, EDX);                      // xor eax, edx
+    emit_rbx(0, {0x88}, EAX, flag_half_offset);     // mov [rbx+flag_half], al
+    emit8(0xC1); emit8(0xEA); emit8(8);             // shr edx, 8
+    emit8(0x83); emit8(0xE2); emit8(1);             // and edx, 1
+    emit_rbx(0, {0x88}, EDX, flag_c_offset);        // mov [rbx+flag_c], dl
+}
+
+// Instructions emitted inline. Mirrors the matching execute_* handlers,
+// including their pc and cycle updates; pc is only stored by the jumps
+// and at the end of the block (compile() does that part).
+bool Jit::emit_native(const DecodedInstruction &op) {
+    uint8_t opcode = (op.instruction >> 16) & 0xFF;
+    uint8_t n = (op.instruction >> 8) & 0xFF;
+    uint16_t nn = static_cast<uint16_t>(n | ((op.instruction & 0xFF) << 8));
+    uint8_t dst = (opcode >> 3) & 0x07;
+    uint8_t src = opcode & 0x07;
+    uint8_t pair = (opcode >> 4) & 0x03;
+    int32_t a = regs_offset + A_REGISTER;
+    int32_t pair_offset = (pair == 3) ? sp_offset : regs_offset + 2 * pair;
+    int32_t cycles = op.cycles;
+
+    switch (op.handler_index) {
+        case HANDLER_LD_20: // LD r, r'
+            emit_rbx(0, {0x0F, 0xB6}, EAX, regs_offset + src);
+            emit_rbx(0, {0x88}, EAX, regs_offset + dst);
+            break;
+        case HANDLER_LD_21: // LD r, n
+            emit_rbx(0, {0xC6}, 0, regs_offset + dst);
+            emit8(n);
+            break;
+        case HANDLER_LD_22: // LD r, (HL)
+            emit_load_pair(ECX, HL_PAIR);
+            emit_read();
+            emit_rbx(0, {0x88}, EAX, regs_offset + dst);
+            break;
+        case HANDLER_LD_23: // LD (HL), r
+            emit_rbx(0, {0x0F, 0xB6}, EAX, regs_offset + src);
+            emit_load_pair(ECX, HL_PAIR);
+            emit_write();
+            break;
+        case HANDLER_LD_24: // LD (HL), n
+            emit8(0xB8); emit32(n);                 // mov eax, n
+            emit_load_pair(ECX, HL_PAIR);
+            emit_write();
+            break;
+        case HANDLER_LD_25: // LD A, (BC)
+        case HANDLER_LD_26: // LD A, (DE)
+            emit_load_pair(ECX, pair);
+            emit_read();
+            emit_rbx(0, {0x88}, EAX, a);
+            break;
+        case HANDLER_LD_27: // LD (BC), A
+        case HANDLER_LD_28: // LD (DE), A
+            emit_rbx(0, {0x0F, 0xB6}, EAX, a);
+            emit_load_pair(ECX, pair);
+            emit_write();
+            break;
+        case HANDLER_LD_29: // LD A, (nn)
+        case HANDLER_LD_33: // LDH A, (n)
+            emit8(0xB9);                            // mov ecx, address
+            emit32(op.handler_index == HANDLER_LD_29 ? nn : 0xFF00 | n);
+            emit_read();
+            emit_rbx(0, {0x88}, EAX, a);
+            break;
+        case HANDLER_LD_30: // LD (nn), A
+        case HANDLER_LD_34: // LDH (n), A
+            emit_rbx(0, {0x0F, 0xB6}, EAX, a);
+            emit8(0xB9);
+            emit32(op.handler_index == HANDLER_LD_30 ? nn : 0xFF00 | n);
+            emit_write();
+            break;
+        case HANDLER_LD_31: // LD A, (C)
+            emit_rbx(0, {0x0F, 0xB6}, ECX, regs_offset + C_REGISTER);
+            emit8(0x81); emit8(0xC9); emit32(0xFF00); // or ecx, 0xFF00
+            emit_read();
+            emit_rbx(0, {0x88}, EAX, a);
+            break;
+        case HANDLER_LD_32: // LD (C), A
+            emit_rbx(0, {0x0F, 0xB6}, EAX, a);
+            emit_rbx(0, {0x0F, 0xB6}, ECX, regs_offset + C_REGISTER);
+            emit8(0x81); emit8(0xC9); emit32(0xFF00);
+            emit_write();
+            break;
+        case HANDLER_LD_35: // LD A, (HL-)
+        case HANDLER_LD_37: // LD A, (HL+)
+            emit_load_pair(ECX, HL_PAIR);
+            emit_read();
+            emit_rbx(0, {0x88}, EAX, a);
+            emit_step_pair(HL_PAIR, op.handler_index == HANDLER_LD_35);
+            break;
+        case HANDLER_LD_36: // LD (HL-), A
+        case HANDLER_LD_38: // LD (HL+), A
+            emit_rbx(0, {0x0F, 0xB6}, EAX, a);
+            emit_load_pair(ECX, HL_PAIR);
+            emit_write();
+            emit_step_pair(HL_PAIR, op.handler_index == HANDLER_LD_36);
+            break;
+        case HANDLER_LD_39: // LD rr, nn
+            emit8(0x66); emit_rbx(0, {0xC7}, 0, pair_offset);
+            emit16(pair == 3 ? nn : static_cast<uint16_t>((nn << 8) | (nn >> 8))); // BC, DE, HL high byte first
+            break;
+        case HANDLER_LD_41: // LD SP, HL
+            emit_load_pair(EAX, HL_PAIR);
+            emit8(0x66); emit_rbx(0, {0x89}, EAX, sp_offset);
+            break;
+        case HANDLER_POP_43: // POP rr (AF unpacks the flags: handler)
+            if (pair == 3) {
+                return false;
+            }
+            emit_pop();
+            emit_store_pair(EAX, pair);
+            break;
+
+        case HANDLER_ADD_45: case HANDLER_ADC_48: case HANDLER_SUB_51: case HANDLER_SBC_54:
+        case HANDLER_CP_57: case HANDLER_AND_64: case HANDLER_OR_67: case HANDLER_XOR_70:
+            emit_rbx(0, {0x0F, 0xB6}, ECX, regs_offset + src);
+            emit_alu(dst);
+            break;
+        case HANDLER_ADD_46: case HANDLER_ADC_49: case HANDLER_SUB_52: case HANDLER_SBC_55:
+        case HANDLER_CP_58: case HANDLER_AND_65: case HANDLER_OR_68: case HANDLER_XOR_71:
+            emit_load_pair(ECX, HL_PAIR);
+            emit_read();
+            emit_rr(OP_MOV, ECX, EAX);              // mov ecx, eax
+            emit_alu(dst);
+            break;
+        case HANDLER_ADD_47: case HANDLER_ADC_50: case HANDLER_SUB_53: case HANDLER_SBC_56:
+        case HANDLER_CP_59: case HANDLER_AND_66: case HANDLER_OR_69: case HANDLER_XOR_72:
+            emit8(0xB9); emit32(n);                 // mov ecx, n
+            emit_alu(dst);
+            break;
+
+        case HANDLER_INC_60: // INC r / DEC r: H is bit 4 of old ^ new, C is kept
+        case HANDLER_DEC_62:
+        case HANDLER_INC_61: // INC (HL) / DEC (HL)
+        case HANDLER_DEC_63: {
+            bool memory = (op.handler_index == HANDLER_INC_61 || op.handler_index == HANDLER_DEC_63);
+            bool dec = (op.handler_index == HANDLER_DEC_62 || op.handler_index == HANDLER_DEC_63);
+            int32_t reg = regs_offset + dst;
+            if (memory) {
+                emit_load_pair(ECX, HL_PAIR);
+                emit_read();
+            } else {
+                emit_rbx(0, {0x0F, 0xB6}, EAX, reg);
+            }
+            emit8(0x8D); emit8(0x50); emit8(dec ? 0xFF : 0x01); // lea edx, [rax -/+ 1]
+            emit_rbx(0, {0x88}, EDX, flag_result_offset);
+            emit_rbx(0, {0xC6}, 0, flag_n_offset);
+            emit8(dec ? 1 : 0);
+            emit_rr(OP_XOR, EAX, EDX);
+            emit_rbx(0, {0x88}, EAX, flag_half_offset);
+            if (memory) {
+                emit_rr(OP_MOV, EAX, EDX);
+                emit_load_pair(ECX, HL_PAIR);
+                emit_write();
+            } else {
+                emit_rbx(0, {0x88}, EDX, reg);
+            }
+            break;
+        }
+        case HANDLER_CCF_73:
+        case HANDLER_SCF_74:
+            emit_rbx(0, {0xC6}, 0, flag_n_offset);
+            emit8(0);
+            emit_rbx(0, {0xC6}, 0, flag_half_offset);
+            emit8(0);
+            if (op.handler_index == HANDLER_CCF_73) {
+                emit_rbx(0, {0x80}, 6, flag_c_offset); // xor byte [rbx+flag_c], 1
+            } else {
+                emit_rbx(0, {0xC6}, 0, flag_c_offset);
+            }
+            emit8(1);
+            break;
+        case HANDLER_CPL_76:
+            emit_rbx(0, {0xF6}, 2, a);              // not byte [rbx+A]
+            emit_rbx(0, {0xC6}, 0, flag_n_offset);
+            emit8(1);
+            emit_rbx(0, {0xC6}, 0, flag_half_offset);
+            emit8(0x10);
+            break;
+        case HANDLER_INC_77: // INC rr / DEC rr
+        case HANDLER_DEC_78:
+            emit_step_pair(pair, op.handler_index == HANDLER_DEC_78);
+            break;
+        case HANDLER_ADD_79: // ADD HL, rr: H from bit 12, C from bit 16, Z kept
+            emit_load_pair(EAX, HL_PAIR);
+            emit_load_pair(ECX, pair);
+            emit8(0x8D); emit8(0x14); emit8(0x08);  // lea edx, [rax + rcx]
+            emit_rbx(0, {0xC6}, 0, flag_n_offset);
+            emit8(0);
+            emit_rr(OP_XOR, EAX, ECX);
+            emit_rr(OP_XOR, EAX, EDX);
+            emit8(0xC1); emit8(0xE8); emit8(8);     // shr eax, 8
+            emit_rbx(0, {0x88}, EAX, flag_half_offset);
+            emit_store_pair(EDX, HL_PAIR);          // swaps dx only, bit 16 stays
+            emit8(0xC1); emit8(0xEA); emit8(16);    // shr edx, 16
+            emit_rbx(0, {0x88}, EDX, flag_c_offset);
+            break;
+
+        case HANDLER_BIT_102: // BIT b, r / BIT b, (HL): Z from the bit, C kept
+        case HANDLER_BIT_103: {
+            uint8_t cb = n;
+            if (op.handler_index == HANDLER_BIT_103) {
+                emit_load_pair(ECX, HL_PAIR);
+                emit_read();
+            } else {
+                emit_rbx(0, {0x0F, 0xB6}, EAX, regs_offset + (cb & 0x07));
+            }
+            emit8(0x83); emit8(0xE0); emit8(1 << ((cb >> 3) & 0x07)); // and eax, mask
+            emit_rbx(0, {0x88}, EAX, flag_result_offset);
+            emit_rbx(0, {0xC6}, 0, flag_n_offset);
+            emit8(0);
+            emit_rbx(0, {0xC6}, 0, flag_half_offset);
+            emit8(0x10);
+            break;
+        }
+        case HANDLER_RES_104: // RES b, r / SET b, r
+        case HANDLER_SET_106: {
+            uint8_t cb = n;
+            uint8_t mask = 1 << ((cb >> 3) & 0x07);
+            bool set = (op.handler_index == HANDLER_SET_106);
+            emit_rbx(0, {0x80}, set ? 1 : 4, regs_offset + (cb & 0x07)); // or / and
+            emit8(set ? mask : static_cast<uint8_t>(~mask));
+            break;
+        }
+
+        case HANDLER_JP_109: // JP nn
+            emit_branch(op, false, nn, 4);
+            return true;
+        case HANDLER_JP_110: // JP HL
+            stored_pc = true;
+            emit_load_pair(EAX, HL_PAIR);
+            emit8(0x66); emit_rbx(0, {0x89}, EAX, pc_offset);
+            emit8(0x49); emit8(0x83); emit8(0xC4); emit8(1); // add r12, 1
+            return true;
+        case HANDLER_JP_111: // JP cc, nn
+            emit_branch(op, true, nn, 4);
+            return true;
+        case HANDLER_JR_113: // JR e
+        case HANDLER_JR_114: // JR cc, e
+            emit_branch(op, op.handler_index == HANDLER_JR_114,
+                        static_cast<uint16_t>(op.pc + 2 + static_cast<int8_t>(n)), 3);
+            return true;
+        case HANDLER_RET_119: // RET
+        case HANDLER_RET_120: { // RET cc
+            size_t not_taken = 0;
+            bool conditional = (op.handler_index == HANDLER_RET_120);
+            stored_pc = true;
+            if (conditional) {
+                not_taken = emit_jump32(emit_condition(opcode));
+            }
+            emit_pop();
+            emit8(0x66); emit_rbx(0, {0x89}, EAX, pc_offset);
+            emit8(0x49); emit8(0x83); emit8(0xC4); emit8(conditional ? 5 : 4);
+            if (conditional) {
+                size_t done = emit_jump8(0xEB);
+                bind32(not_taken);
+                emit8(0x66); emit_rbx(0, {0xC7}, 0, pc_offset);
+                emit16(static_cast<uint16_t>(op.pc + 1));
+                emit8(0x49); emit8(0x83); emit8(0xC4); emit8(op.cycles);
+                bind8(done);
+            }
+            return true;
+        }
+        case HANDLER_DI_123: // ends the block
+            stored_pc = true;
+            emit_rbx(0, {0xC6}, 0, ime_offset);     // mov byte [rbx+ime], 0
+            emit8(0);
+            emit8(0x66); emit_rbx(0, {0xC7}, 0, pc_offset);
+            emit16(static_cast<uint16_t>(op.pc + 1));
+            emit8(0x49); emit8(0x83); emit8(0xC4); emit8(1);
+            return true;
+        case HANDLER_NOP_125:
+            break;
+        default:
+            return false;
+    }
+
+    emit8(0x49); emit8(0x83); emit8(0xC4);          // add r12, cycles
+    emit8(static_cast<uint8_t>(cycles));
+    return true;
+}
+
+bool Jit::compile(BasicBlock *block, CPU *cpu) {
+    if (!arena || !arena_executable) {
+        return false;
+    }
+    if (regs_offset < 0) {
+        find_offsets(cpu);
+    }
+
+    code.clear();
+    exits.clear();
+    finish_jumps.clear();
+    // Idle loops are fast-forwarded by the CPU on entry instead
+    loop_pc = block->idle_loop ? -1 : block->start_pc;
+
+    // Prologue: six pushes and 8 bytes keep rsp 16-aligned for calls
+    emit8(0x53);                                   // push rbx
+    emit8(0x55);                                   // push rbp
+    emit8(0x41); emit8(0x54);                      // push r12
+    emit8(0x41); emit8(0x55);                      // push r13
+    emit8(0x41); emit8(0x56);                      // push r14
+    emit8(0x41); emit8(0x57);                      // push r15
+    emit8(0x48); emit8(0x83); emit8(0xEC); emit8(8); // sub rsp, 8
+    emit8(0xC7); emit8(0x04); emit8(0x24); emit32(0); // mov dword [rsp], 0 (passes)
+    emit8(0x48); emit8(0x89); emit8(0xFB);         // mov rbx, rdi
+    emit8(0x49); emit8(0x89); emit8(0xF5);         // mov r13, rsi
+    emit8(0x45); emit8(0x8B); emit8(0x75); emit8(0x00); // mov r14d, [r13]
+    emit_rbx(0x48, {0x8B}, 5, bus_offset);         // mov rbp, [rbx+bus]
+    emit_rbx(0x48, {0x8B}, R12, cycles_offset);    // mov r12, [rbx+cycles]
+    emit_rbx(0x48, {0x8B}, R15, run_target_offset); // mov r15, [rbx+run_target]
+
+    const std::vector<DecodedInstruction> &ops = block->instructions;
+    uint32_t count = static_cast<uint32_t>(ops.size());
+    size_t mid_block_entry = 0;
+    if (count > 1) {
+        emit8(0x85); emit8(0xD2);                  // test edx, edx
+        emit8(0x0F); emit8(0x80 | JCC_NE);         // jnz mid_block_entry
+        mid_block_entry = code.size();
+        emit32(0);
+    }
+    loop_start = code.size();
+
+    op_starts.clear();
+    for (uint32_t i = 0; i < count; i++) {
+        const DecodedInstruction &op = ops[i];
+        op_starts.push_back(code.size());
+        bool last = (i + 1 == count);
+        bool called_handler = false;
+
+        wrote_memory = false;
+        stored_pc = false;
+        if (!emit_native(op)) {
+            // The handler works on the CPU in memory, pc included
+            emit8(0x66); emit_rbx(0, {0xC7}, 0, pc_offset); // mov word [rbx+pc], op.pc
+            emit16(op.pc);
+            emit8(0x48); emit8(0x89); emit8(0xDF); // mov rdi, rbx
+            emit8(0xBE); emit32(op.instruction);   // mov esi, instruction
+            emit_call(reinterpret_cast<const void *>(jit_thunks[op.handler_index]));
+            called_handler = true;
+        } else if (last && !stored_pc) {
+            emit8(0x66); emit_rbx(0, {0xC7}, 0, pc_offset); // mov word [rbx+pc], next
+            emit16(static_cast<uint16_t>(op.pc + op.length));
+        }
+        if (last) {
+            break;
+        }
+
+        // The handler or bus may have written over cached code
+        if (called_handler || wrote_memory) {
+            emit8(0x45); emit8(0x39); emit8(0x75); emit8(0x00); // cmp [r13], r14d
+            emit_exit(JCC_NE, i + 1);
+        }
+        // Same budget check as CPU::run after every instruction
+        emit8(0x4D); emit8(0x39); emit8(0xFC);     // cmp r12, r15
+        emit_exit(JCC_AE, i + 1);
+    }
+    size_t finish = code.size();
+    emit8(0xB8); emit32(count);                    // mov eax, count
+
+    size_t epilogue = code.size();
+    emit_rbx(0x48, {0x89}, R12, cycles_offset);    // mov [rbx+cycles], r12
+    emit8(0x8B); emit8(0x14); emit8(0x24);         // mov edx, [rsp]
+    emit8(0x48); emit8(0xC1); emit8(0xE2); emit8(32); // shl rdx, 32
+    emit8(0x48); emit8(0x09); emit8(0xD0);         // or rax, rdx
+    emit8(0x48); emit8(0x83); emit8(0xC4); emit8(8); // add rsp, 8
+    emit8(0x41); emit8(0x5F);                      // pop r15
+    emit8(0x41); emit8(0x5E);                      // pop r14
+    emit8(0x41); emit8(0x5D);                      // pop r13
+    emit8(0x41); emit8(0x5C);                      // pop r12
+    emit8(0x5D);                                   // pop rbp
+    emit8(0x5B);                                   // pop rbx
+    emit8(0xC3);                                   // ret
+
+    // One exit per instruction that has any: the pc of the next
+    // instruction (handlers have stored the same one) and the count
+    size_t stub = 0;
+    uint32_t stub_executed = 0; // exits come after at least one instruction
+    for (const std::pair<size_t, uint32_t> &exit : exits) {
+        if (exit.second != stub_executed) {
+            stub = code.size();
+            stub_executed = exit.second;
+            emit8(0x66); emit_rbx(0, {0xC7}, 0, pc_offset); // mov word [rbx+pc], pc
+            emit16(ops[stub_executed].pc);
+            emit8(0xB8); emit32(stub_executed);    // mov eax, executed
+            emit8(0xE9);                           // jmp epilogue
+            emit32(static_cast<uint32_t>(epilogue - (code.size() + 4)));
+        }
+        uint32_t rel = static_cast<uint32_t>(stub - (exit.first + 4));
+        memcpy(&code[exit.first], &rel, sizeof(rel));
+    }
+
+    // Entering at instruction index: a table of offsets from the table
+    if (mid_block_entry) {
+        uint32_t rel = static_cast<uint32_t>(code.size() - (mid_block_entry + 4));
+        memcpy(&code[mid_block_entry], &rel, sizeof(rel));
+        emit_rr(OP_MOV, EDX, EDX);                 // mov edx, edx (zero the top half)
+        emit8(0x48); emit8(0x8D); emit8(0x0D);     // lea rcx, [rip + table]
+        emit32(4 + 3 + 2);                         // the three instructions below
+        emit8(0x48); emit8(0x63); emit8(0x04); emit8(0x91); // movsxd rax, dword [rcx + rdx*4]
+        emit8(0x48); emit8(0x01); emit8(0xC8);     // add rax, rcx
+        emit8(0xFF); emit8(0xE0);                  // jmp rax
+        size_t table = code.size();
+        for (size_t op_start : op_starts) {
+            emit32(static_cast<uint32_t>(static_cast<int32_t>(op_start) - static_cast<int32_t>(table)));
+        }
+    }
+
+    for (size_t pos : finish_jumps) {
+        uint32_t rel = static_cast<uint32_t>(finish - (pos + 4));
+        memcpy(&code[pos], &rel, sizeof(rel));
+    }
+
+    size_t start = (arena_used + 15) & ~static_cast<size_t>(15);
+    if (start + code.size() > arena_size) {
+        return false;
+    }
+
+    // Keep the arena W^X: only the pages the block lands on are made
+    // writable, and only while it is copied in
+    size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t first_page = start & ~(page_size - 1);
+    size_t end_page = (start + code.size() + page_size - 1) & ~(page_size - 1);
+    if (mprotect(arena + first_page, end_page - first_page, PROT_READ | PROT_WRITE) != 0) {
+        std::cerr << "JIT Warning: could not make the code arena writable" << std::endl;
+        return false;
+    }
+    memcpy(arena + start, code.data(), code.size());
+    if (mprotect(arena + first_page, end_page - first_page, PROT_READ | PROT_EXEC) != 0) {
+        // Blocks already on these pages cannot run either: stop using the arena
+        std::cerr << "JIT Warning: could not make the code arena executable, blocks will be interpreted"
+                  << std::endl;
+        arena_executable = false;
+        return false;
+    }
+    arena_used = start + code.size();
+
+    block->native = arena + start;
+    blocks_compiled++;
+    return true;
+}
+
+uint32_t Jit::execute(CPU *cpu, const DecodedInstruction *ops, uint32_t count, uint32_t index,
+                      void *native, const uint32_t *generation) {
+    JitCode entry = reinterpret_cast<JitCode>(native);
+    native_runs++;
+    if (differential) {
+        return execute_checked(cpu, ops, count, index, entry, generation);
+    }
+    return static_cast<uint32_t>(entry(cpu, generation, index));
+}
+
+// Run the native code, keep its final state aside, rewind to the snapshot
+// and replay the same instructions through the interpreter. The
+// interpreter's state is kept either way. Besides the CPU and memory the
+// snapshot covers what bus accesses reach: IE/IF, the timer and the
+// scheduler's events.
+uint32_t Jit::execute_checked(CPU *cpu, const DecodedInstruction *ops, uint32_t count, uint32_t index,
+                              JitCode native, const uint32_t *generation) {
+    Bus *bus = cpu->bus;
+    InterruptHandler *IH = cpu->IH;
+    Timer *timer = bus->timer;
+    Scheduler *scheduler = bus->scheduler;
+
+    CPU cpu_before = *cpu;
+    *bus_before = *bus;
+    if (IH) {
+        IH_before = *IH;
+    }
+    if (timer) {
+        timer_before = *timer;
+    }
+    if (scheduler) {
+        scheduler_before = *scheduler;
+    }
+
+    uint64_t result = native(cpu, generation, index);
+    uint32_t next = static_cast<uint32_t>(result);
+    uint64_t steps = (result >> 32) * count + next - index;
+
+    CPU cpu_native = *cpu;
+    *bus_native = *bus;
+    if (IH) {
+        IH_native = *IH;
+        *IH = IH_before;
+    }
+    if (timer) {
+        timer_native = *timer;
+        *timer = timer_before;
+    }
+    if (scheduler) {
+        scheduler_native = *scheduler;
+        *scheduler = scheduler_before;
+    }
+
+    *cpu = cpu_before;
+    *bus = *bus_before;
+    for (uint64_t i = 0; i < steps; i++) {
+        cpu->execute_instruction(ops[(index + i) % count].instruction);
+    }
+
+    cpu->materialize_flags();
+    cpu_native.materialize_flags();
+    bool same = memcmp(&cpu->regs, &cpu_native.regs, sizeof(cpu->regs)) == 0 &&
+                cpu->pc == cpu_native.pc && cpu->sp == cpu_native.sp &&
+                cpu->cycles == cpu_native.cycles && cpu->run_target == cpu_native.run_target &&
+                cpu->ime == cpu_native.ime && cpu->halted == cpu_native.halted &&
+                bus->transfer_pending == bus_native->transfer_pending &&
+                bus->same_memory(*bus_native);
+    if (IH) {
+        same = same && IH->get_IE() == IH_native.get_IE() && IH->get_IF() == IH_native.get_IF() &&
+               IH->get_pending() == IH_native.get_pending();
+    }
+    if (timer) {
+        same = same && timer->same_state(timer_native);
+    }
+    if (scheduler) {
+        same = same && scheduler->same_events(scheduler_native);
+    }
+    if (!same) {
+        if (mismatches < 10) {
+            std::cerr << std::hex << "JIT mismatch in block at 0x" << ops[index].pc << " after " << std::dec
+                      << steps << " instructions: pc " << std::hex << cpu_native.pc << " vs "
+                      << cpu->pc << ", sp " << cpu_native.sp << " vs " << cpu->sp << std::dec
+                      << ", cycles " << cpu_native.cycles << " vs " << cpu->cycles << std::endl;
+        }
+        mismatches++;
+    }
+    return next;
+}
+
+#endif // ENABLE_JIT
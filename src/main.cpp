@@ -6,11 +6,10 @@
 int main(int argc, char* argv[]) {
 	if (argc != 2) {
 		std::cerr << "Usage: " << argv[0] << " <rom_file>\n";
-		std::cerr << "Please place the ROM file in the /games/ directory, and just type the game file name (not path).\n";
+		std::cerr << "Give a path to the ROM, or just the file name of a ROM in the /games/ directory.\n";
 		return 1;
 	}
-	std::string rom_path (argv[1]);
-	rom_path = "./games/" + rom_path;
+	std::string rom_path = Emulator::find_rom(argv[1]);
 	GheithBoy gb;
 	gb.run_gb(rom_path);
 }
\ No newline at end of file
@@ -0,0 +1,265 @@
+#include "../include/pixel_kernels.hpp"
+#include <iostream>
+#include <string.h>
+
+#if !defined(PIXEL_NO_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PIXEL_X86
+#include <immintrin.h>
+#endif
+
+// Scalar kernels: the reference for the vector ones
+
+static void decode_tile_scalar(const uint8_t *data, uint8_t pixels[8][8]) {
+    for (int y = 0; y < 8; y++) {
+        uint8_t lsbs = data[y * 2];
+        uint8_t msbs = data[y * 2 + 1];
+        for (int x = 0; x < 8; x++) {
+            int shift = 7 - x;
+            pixels[y][x] = ((lsbs >> shift) & 1) | (((msbs >> shift) & 1) << 1);
+        }
+    }
+}
+
+static void map_palette_scalar(const uint8_t *indices, uint8_t palette, uint8_t *out, int count) {
+    for (int i = 0; i < count; i++) {
+        out[i] = (palette >> (indices[i] * 2)) & 0b11;
+    }
+}
+
+static void to_argb_scalar(const uint8_t *colors, uint32_t *out, int count) {
+    for (int i = 0; i < count; i++) {
+        switch (colors[i]) {
+        case WHITE_OR_TRANSPARENT:
+            out[i] = 0xFFFFFFFF;
+            break;
+        case LIGHT_GRAY:
+            out[i] = 0xFFAAAAAA;
+            break;
+        case DARK_GRAY:
+            out[i] = 0xFF555555;
+            break;
+        case BLACK:
+            out[i] = 0xFF000000;
+            break;
+        default:
+            out[i] = 0xFFFFFFFF;
+        }
+    }
+}
+
+static const PixelKernels SCALAR_KERNELS = {"scalar", decode_tile_scalar, map_palette_scalar, to_argb_scalar};
+
+#ifdef PIXEL_X86
+
+// SSE2: a row's two bytes as one 16-bit word (lsbs | msbs << 8), broadcast
+// so that lane x tests pixel x's bit in both planes
+__attribute__((target("sse2")))
+static void decode_tile_sse2(const uint8_t *data, uint8_t pixels[8][8]) {
+    const __m128i bits = _mm_set_epi16(0x0101, 0x0202, 0x0404, 0x0808, 0x1010, 0x2020, 0x4040,
+                                       static_cast<short>(0x8080));
+    const __m128i weights = _mm_set1_epi16(0x0201); // 1 for the lsbs plane, 2 for the msbs plane
+    const __m128i low_byte = _mm_set1_epi16(0x00FF);
+    for (int y = 0; y < 8; y += 2) {
+        __m128i rows[2];
+        for (int i = 0; i < 2; i++) {
+            short word = static_cast<short>(data[(y + i) * 2] | (data[(y + i) * 2 + 1] << 8));
+            __m128i planes = _mm_and_si128(_mm_set1_epi16(word), bits);
+            planes = _mm_and_si128(_mm_cmpeq_epi8(planes, bits), weights);
+            rows[i] = _mm_add_epi16(_mm_srli_epi16(planes, 8), _mm_and_si128(planes, low_byte));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pixels[y]), _mm_packus_epi16(rows[0], rows[1]));
+    }
+}
+
+// Select each index's shade with compares
+__attribute__((target("sse2")))
+static void map_palette_sse2(const uint8_t *indices, uint8_t palette, uint8_t *out, int count) {
+    __m128i shades[4];
+    for (int s = 0; s < 4; s++) {
+        shades[s] = _mm_set1_epi8(static_cast<char>((palette >> (s * 2)) & 0b11));
+    }
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i index = _mm_loadu_si128(reinterpret_cast<const __m128i *>(indices + i));
+        __m128i colors = _mm_setzero_si128();
+        for (int s = 0; s < 4; s++) {
+            __m128i match = _mm_cmpeq_epi8(index, _mm_set1_epi8(static_cast<char>(s)));
+            colors = _mm_or_si128(colors, _mm_and_si128(match, shades[s]));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), colors);
+    }
+    map_palette_scalar(indices + i, palette, out + i, count - i);
+}
+
+// Widen 16 colors to 32-bit lanes; the shades are 0xFF - 0x55 * color in
+// each of R, G and B
+__attribute__((target("sse2")))
+static void to_argb_sse2(const uint8_t *colors, uint32_t *out, int count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ff = _mm_set1_epi32(0xFF);
+    const __m128i opaque = _mm_set1_epi32(static_cast<int>(0xFF000000));
+    const __m128i last_shade = _mm_set1_epi32(BLACK);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(colors + i));
+        __m128i words[2] = {_mm_unpacklo_epi8(bytes, zero), _mm_unpackhi_epi8(bytes, zero)};
+        for (int j = 0; j < 4; j++) {
+            __m128i color = (j & 1) ? _mm_unpackhi_epi16(words[j >> 1], zero) : _mm_unpacklo_epi16(words[j >> 1], zero);
+            __m128i times_55 = _mm_add_epi32(_mm_add_epi32(color, _mm_slli_epi32(color, 2)),
+                                             _mm_add_epi32(_mm_slli_epi32(color, 4), _mm_slli_epi32(color, 6)));
+            __m128i level = _mm_sub_epi32(ff, times_55);
+            __m128i gray = _mm_or_si128(_mm_or_si128(level, _mm_slli_epi32(level, 8)),
+                                        _mm_or_si128(_mm_slli_epi32(level, 16), opaque));
+            // color > BLACK: all ones, which is white
+            __m128i other = _mm_cmpgt_epi32(color, last_shade);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + j * 4), _mm_or_si128(gray, other));
+        }
+    }
+    to_argb_scalar(colors + i, out + i, count - i);
+}
+
+static const PixelKernels SSE2_KERNELS = {"sse2", decode_tile_sse2, map_palette_sse2, to_argb_sse2};
+
+// AVX2: spread each row's bytes over its 8 pixels with a byte shuffle,
+// four rows per register
+__attribute__((target("avx2")))
+static void decode_tile_avx2(const uint8_t *data, uint8_t pixels[8][8]) {
+    const __m256i tile = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data)));
+    const __m256i bits = _mm256_set1_epi64x(0x0102040810204080); // pixel x tests bit 7 - x
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i two = _mm256_set1_epi8(2);
+    const long long next_row = 0x0202020202020202; // two bytes per row, in every byte
+    for (int half = 0; half < 2; half++) {
+        long long first = 0x0808080808080808 * half;
+        __m256i lsbs_index = _mm256_setr_epi64x(first, first + next_row, first + 2 * next_row, first + 3 * next_row);
+        __m256i msbs_index = _mm256_add_epi8(lsbs_index, one);
+        __m256i lsbs = _mm256_shuffle_epi8(tile, lsbs_index);
+        __m256i msbs = _mm256_shuffle_epi8(tile, msbs_index);
+        lsbs = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(lsbs, bits), bits), one);
+        msbs = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(msbs, bits), bits), two);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(pixels[half * 4]), _mm256_or_si256(lsbs, msbs));
+    }
+}
+
+// Look the indices up in a 4-entry byte table, 32 at a time
+__attribute__((target("avx2")))
+static void map_palette_avx2(const uint8_t *indices, uint8_t palette, uint8_t *out, int count) {
+    const __m256i table = _mm256_broadcastsi128_si256(
+        _mm_setr_epi8(palette & 0b11, (palette >> 2) & 0b11, (palette >> 4) & 0b11, (palette >> 6) & 0b11, 0, 0, 0,
+                      0, 0, 0, 0, 0, 0, 0, 0, 0));
+    int i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(indices + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_shuffle_epi8(table, index));
+    }
+    map_palette_scalar(indices + i, palette, out + i, count - i);
+}
+
+// One 8-entry table lookup per 8 pixels
+__attribute__((target("avx2")))
+static void to_argb_avx2(const uint8_t *colors, uint32_t *out, int count) {
+    const __m256i shades = _mm256_setr_epi32(
+        static_cast<int>(0xFFFFFFFF), static_cast<int>(0xFFAAAAAA), static_cast<int>(0xFF555555),
+        static_cast<int>(0xFF000000), static_cast<int>(0xFFFFFFFF), static_cast<int>(0xFFFFFFFF),
+        static_cast<int>(0xFFFFFFFF), static_cast<int>(0xFFFFFFFF));
+    const __m256i seven = _mm256_set1_epi32(7);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(colors + i));
+        __m256i color = _mm256_cvtepu8_epi32(bytes);
+        __m256i argb = _mm256_permutevar8x32_epi32(shades, color); // uses the low 3 bits
+        // Colors past the table are white
+        argb = _mm256_or_si256(argb, _mm256_cmpgt_epi32(color, seven));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), argb);
+    }
+    to_argb_scalar(colors + i, out + i, count - i);
+}
+
+static const PixelKernels AVX2_KERNELS = {"avx2", decode_tile_avx2, map_palette_avx2, to_argb_avx2};
+
+#endif // PIXEL_X86
+
+int available_pixel_kernels(const PixelKernels *kernels[3]) {
+    int count = 0;
+    kernels[count++] = &SCALAR_KERNELS;
+#ifdef PIXEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        kernels[count++] = &SSE2_KERNELS;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        kernels[count++] = &AVX2_KERNELS;
+    }
+#endif
+    return count;
+}
+
+const PixelKernels &pixel_kernels() {
+    static const PixelKernels *best = [] {
+        const PixelKernels *kernels[3];
+        return kernels[available_pixel_kernels(kernels) - 1];
+    }();
+    return *best;
+}
+
+bool pixel_kernels_verify(const PixelKernels &k) {
+    // Every (lsbs, msbs) row, eight to a tile
+    for (int first = 0; first < 0x10000; first += 8) {
+        uint8_t data[16];
+        for (int y = 0; y < 8; y++) {
+            data[y * 2] = static_cast<uint8_t>(first + y);
+            data[y * 2 + 1] = static_cast<uint8_t>((first + y) >> 8);
+        }
+        uint8_t expected[8][8], actual[8][8];
+        decode_tile_scalar(data, expected);
+        k.decode_tile(data, actual);
+        if (memcmp(expected, actual, sizeof(expected)) != 0) {
+            std::cerr << k.name << " decode_tile differs for rows from 0x" << std::hex << first << std::dec << std::endl;
+            return false;
+        }
+    }
+
+    // Every palette, over lengths around the vector widths
+    const int LENGTH = 168;
+    const int counts[] = {0, 1, 7, 8, 15, 16, 17, 160, LENGTH};
+    uint8_t indices[LENGTH];
+    uint32_t state = 0x2545F491;
+    for (int i = 0; i < LENGTH; i++) {
+        state = state * 1664525u + 1013904223u;
+        indices[i] = state >> 30;
+    }
+    for (int palette = 0; palette < 256; palette++) {
+        for (int count : counts) {
+            uint8_t expected[LENGTH], actual[LENGTH];
+            memset(expected, 0xAB, sizeof(expected));
+            memset(actual, 0xAB, sizeof(actual));
+            map_palette_scalar(indices, palette, expected, count);
+            k.map_palette(indices, palette, actual, count);
+            if (memcmp(expected, actual, sizeof(expected)) != 0) {
+                std::cerr << k.name << " map_palette differs for palette " << palette << ", count " << count
+                          << std::endl;
+                return false;
+            }
+        }
+    }
+
+    // Every byte value, at every offset within a vector
+    uint8_t colors[LENGTH + 256];
+    for (int i = 0; i < LENGTH + 256; i++) {
+        colors[i] = static_cast<uint8_t>(i * 5 + i / 256);
+    }
+    for (int start = 0; start < 256; start++) {
+        for (int count : counts) {
+            uint32_t expected[LENGTH], actual[LENGTH];
+            memset(expected, 0xAB, sizeof(expected));
+            memset(actual, 0xAB, sizeof(actual));
+            to_argb_scalar(colors + start, expected, count);
+            k.to_argb(colors + start, actual, count);
+            if (memcmp(expected, actual, sizeof(expected)) != 0) {
+                std::cerr << k.name << " to_argb differs from offset " << start << ", count " << count << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
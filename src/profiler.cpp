@@ -0,0 +1,95 @@
+#include "../include/profiler.hpp"
+
+#ifdef ENABLE_PROFILER
+
+#include <string.h>
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include "../include/cpu.hpp"
+
+Profiler::Profiler() {
+    memset(opcode_count, 0, sizeof(opcode_count));
+    memset(opcode_cycles, 0, sizeof(opcode_cycles));
+    memset(cb_count, 0, sizeof(cb_count));
+    memset(cb_cycles, 0, sizeof(cb_cycles));
+    memset(pc_count, 0, sizeof(pc_count));
+    memset(pc_cycles, 0, sizeof(pc_cycles));
+    memset(pc_instruction, 0, sizeof(pc_instruction));
+}
+
+// One line of the report
+struct ProfileEntry {
+    uint32_t key;         // instruction word, or PC
+    uint32_t instruction; // for the name
+    uint64_t count;
+    uint64_t cycles;
+};
+
+static void print_entries(std::ostream &out, CPU &cpu, std::vector<ProfileEntry> &entries,
+                          uint64_t total_cycles, bool by_pc) {
+    std::sort(entries.begin(), entries.end(), [](const ProfileEntry &a, const ProfileEntry &b) {
+        return a.cycles != b.cycles ? a.cycles > b.cycles : a.key < b.key;
+    });
+    for (const ProfileEntry &e : entries) {
+        std::ostringstream key;
+        key << std::hex << std::uppercase << std::setfill('0');
+        if (by_pc) {
+            key << "0x" << std::setw(4) << e.key;
+        } else if ((e.instruction >> 16) == 0xCB) {
+            key << "CB " << std::setw(2) << ((e.instruction >> 8) & 0xFF);
+        } else {
+            key << std::setw(2) << (e.instruction >> 16);
+        }
+        out << "  " << std::left << std::setw(8) << key.str() << std::setw(10)
+            << cpu.get_instruction_name(e.instruction) << std::right << std::setw(14) << e.count
+            << std::setw(16) << e.cycles << std::setw(8) << std::fixed << std::setprecision(2)
+            << (total_cycles ? 100.0 * e.cycles / total_cycles : 0.0) << "%\n";
+    }
+}
+
+void Profiler::report(std::ostream &out, CPU &cpu, size_t top_pcs) const {
+    uint64_t total_count = 0;
+    uint64_t total_cycles = 0;
+    std::vector<ProfileEntry> opcodes;
+    for (uint32_t i = 0; i < 256; i++) {
+        if (opcode_count[i]) {
+            opcodes.push_back({i << 16, i << 16, opcode_count[i], opcode_cycles[i]});
+        }
+        if (cb_count[i]) {
+            uint32_t instruction = (0xCBu << 16) | (i << 8);
+            opcodes.push_back({instruction, instruction, cb_count[i], cb_cycles[i]});
+        }
+        total_count += opcode_count[i] + cb_count[i];
+        total_cycles += opcode_cycles[i] + cb_cycles[i];
+    }
+
+    std::vector<ProfileEntry> pcs;
+    for (uint32_t pc = 0; pc < 0x10000; pc++) {
+        if (pc_count[pc]) {
+            pcs.push_back({pc, pc_instruction[pc], pc_count[pc], pc_cycles[pc]});
+        }
+    }
+
+    std::ios::fmtflags flags = out.flags();
+    out << "Profile: " << total_count << " instructions, " << total_cycles << " M-cycles\n\n"
+        << "Opcodes by M-cycles:\n"
+        << "  " << std::left << std::setw(8) << "opcode" << std::setw(10) << "handler" << std::right
+        << std::setw(14) << "executions" << std::setw(16) << "M-cycles" << std::setw(9) << "share" << "\n";
+    print_entries(out, cpu, opcodes, total_cycles, false);
+
+    if (pcs.size() > top_pcs) {
+        std::partial_sort(pcs.begin(), pcs.begin() + top_pcs, pcs.end(),
+                          [](const ProfileEntry &a, const ProfileEntry &b) { return a.cycles > b.cycles; });
+        pcs.resize(top_pcs);
+    }
+    out << "\nTop " << pcs.size() << " PCs by M-cycles:\n"
+        << "  " << std::left << std::setw(8) << "pc" << std::setw(10) << "handler" << std::right
+        << std::setw(14) << "executions" << std::setw(16) << "M-cycles" << std::setw(9) << "share" << "\n";
+    print_entries(out, cpu, pcs, total_cycles, true);
+    out.flags(flags);
+}
+
+#endif // ENABLE_PROFILER
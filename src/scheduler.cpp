@@ -0,0 +1,75 @@
+#include "../include/scheduler.hpp"
+#include "../include/cpu.hpp"
+
+Scheduler::Scheduler() : count(0), cpu(nullptr) {}
+
+void Scheduler::connect_cpu(CPU *cpu) {
+    this->cpu = cpu;
+}
+
+uint64_t Scheduler::now() const {
+    return cpu ? cpu->get_cycles() : 0;
+}
+
+void Scheduler::remove(EventType type) {
+    for (uint8_t i = 0; i < count; i++) {
+        if (events[i].type == type) {
+            for (uint8_t j = i + 1; j < count; j++) {
+                events[j - 1] = events[j];
+            }
+            count--;
+            return;
+        }
+    }
+}
+
+void Scheduler::schedule(EventType type, uint64_t time) {
+    remove(type);
+
+    // Insertion sort; events due at the same time keep scheduling order
+    uint8_t i = count;
+    while (i > 0 && events[i - 1].time > time) {
+        events[i] = events[i - 1];
+        i--;
+    }
+    events[i] = {time, type};
+    count++;
+
+    if (cpu) {
+        cpu->limit_run(time);
+    }
+}
+
+void Scheduler::cancel(EventType type) {
+    remove(type);
+}
+
+bool Scheduler::pop_due(uint64_t now, Event &event) {
+    if (count == 0 || events[0].time > now) {
+        return false;
+    }
+    event = events[0];
+    for (uint8_t i = 1; i < count; i++) {
+        events[i - 1] = events[i];
+    }
+    count--;
+    return true;
+}
+
+void Scheduler::end_slice() {
+    if (cpu) {
+        cpu->limit_run(0);
+    }
+}
+
+bool Scheduler::same_events(const Scheduler &other) const {
+    if (count != other.count) {
+        return false;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        if (events[i].time != other.events[i].time || events[i].type != other.events[i].type) {
+            return false;
+        }
+    }
+    return true;
+}
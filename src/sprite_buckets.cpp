@@ -0,0 +1,46 @@
+#include "../include/sprite_buckets.hpp"
+#include <string.h>
+
+SpriteBuckets::SpriteBuckets() {
+    memset(sprites, 0, sizeof(sprites));
+    memset(counts, 0, sizeof(counts));
+    oam = nullptr;
+    dirty = true;
+    built_tall = false;
+    rebuilds = 0;
+}
+
+void SpriteBuckets::rebuild(bool tall) {
+    const int SPRITE_Y_OFFSET = 16;
+    int height = tall ? 16 : 8;
+    memset(counts, 0, sizeof(counts));
+
+    // In OAM order, so each line keeps the first 10 sprites on it
+    for (int i = 0; i < 40; i++) {
+        int top = oam[i * 4] - SPRITE_Y_OFFSET;
+        uint8_t x = oam[i * 4 + 1];
+        if (x == 0) {
+            continue; // X = 0 hides the sprite, and it doesn't count towards the 10
+        }
+        int first = top < 0 ? 0 : top;
+        int last = top + height < LINES ? top + height : LINES; // one past
+        for (int row = first; row < last; row++) {
+            uint8_t *bucket = sprites[row];
+            int count = counts[row];
+            if (count == MAX_PER_LINE) {
+                continue;
+            }
+            // Insert after every sprite with X <= x: those came earlier in OAM
+            int pos = count;
+            while (pos > 0 && oam[bucket[pos - 1] * 4 + 1] > x) {
+                bucket[pos] = bucket[pos - 1];
+                pos--;
+            }
+            bucket[pos] = i;
+            counts[row] = count + 1;
+        }
+    }
+    dirty = false;
+    built_tall = tall;
+    rebuilds++;
+}
@@ -0,0 +1,20 @@
+#include "../include/tile_cache.hpp"
+#include <string.h>
+
+TileCache::TileCache() {
+    memset(pixels, 0, sizeof(pixels));
+    vram = nullptr;
+    kernels = &pixel_kernels();
+    tiles_decoded = 0;
+    invalidate_all();
+}
+
+void TileCache::invalidate_all() {
+    memset(dirty, 0xFF, sizeof(dirty));
+}
+
+void TileCache::decode(int tile) {
+    kernels->decode_tile(&vram[tile * 16], pixels[tile]);
+    dirty[tile >> 6] &= ~(uint64_t(1) << (tile & 63));
+    tiles_decoded++;
+}
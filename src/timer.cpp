@@ -1,23 +1,96 @@
 #include "../include/timer.hpp"
 
 Timer::Timer() {
-	this->mmu = nullptr;
+	this->IH = nullptr;
+	this->scheduler = nullptr;
+	div_start = 0;
+	tima = 0;
+	tima_time = 0;
+	tma = 0;
+	tac = 0;
 }
 
-void Timer::connect_mmu(MMU* mmu) {
-	this->mmu = mmu;
+void Timer::connect_interrupt_handler(InterruptHandler* IH) {
+	this->IH = IH;
 }
 
-void Timer::connect_ram(RAM* ram) {
-	this->ram = ram;
+void Timer::connect_scheduler(Scheduler* scheduler) {
+	this->scheduler = scheduler;
 }
 
-void Timer::tick(uint64_t outsideClock) {
-	outsideClock *= 4;
-	// Update the DIV register every 256 cycles
-	if (outsideClock % 256 == 0) {
-		uint8_t current_div = ram->read_mem(DIVIDER_REG);
-		current_div++;
-		ram->write_mem(DIVIDER_REG, current_div);
-	}	
-}
\ No newline at end of file
+// M-cycles per TIMA increment for the TAC clock select bits
+uint64_t Timer::tima_period() const {
+	static const uint64_t periods[4] = {256, 4, 16, 64};
+	return periods[tac & 0b11];
+}
+
+// TIMA counts falling edges of a bit of the divider, so the increments
+// between two times are the period boundaries crossed since the last DIV
+// reset. The overflow event keeps tima from passing 0xFF here.
+void Timer::sync_tima(uint64_t now) {
+	if (tac & 0b100) {
+		uint64_t period = tima_period();
+		tima += static_cast<uint8_t>((now - div_start) / period - (tima_time - div_start) / period);
+	}
+	tima_time = now;
+}
+
+void Timer::schedule_overflow() {
+	if (!scheduler) {
+		return;
+	}
+	if (!(tac & 0b100)) {
+		scheduler->cancel(EVENT_TIMER);
+		return;
+	}
+	uint64_t period = tima_period();
+	uint64_t edge = (tima_time - div_start) / period + (0x100 - tima);
+	scheduler->schedule(EVENT_TIMER, div_start + edge * period);
+}
+
+uint8_t Timer::read_register(uint16_t addr) {
+	uint64_t now = scheduler ? scheduler->now() : 0;
+	if (addr == DIVIDER_REG) {
+		// DIV is the upper byte of the 16-bit divider (256 T-cycles per step)
+		return static_cast<uint8_t>((now - div_start) >> 6);
+	}
+	if (addr == TIMA_REG) {
+		sync_tima(now);
+		return tima;
+	}
+	if (addr == TMA_REG) {
+		return tma;
+	}
+	return tac | 0xF8; // TAC: unused bits read as 1
+}
+
+void Timer::write_register(uint16_t addr, uint8_t data) {
+	uint64_t now = scheduler ? scheduler->now() : 0;
+	sync_tima(now);
+	if (addr == DIVIDER_REG) {
+		div_start = now; // Any write resets DIV to 0
+	} else if (addr == TIMA_REG) {
+		tima = data;
+	} else if (addr == TMA_REG) {
+		tma = data;
+		return;
+	} else {
+		tac = data & 0b111;
+	}
+	schedule_overflow();
+}
+
+void Timer::handle_event(uint64_t time) {
+	// TIMA wraps: reload from TMA and request the interrupt
+	tima = tma;
+	tima_time = time;
+	if (IH) {
+		IH->enable_TIMER_interrupt();
+	}
+	schedule_overflow();
+}
+
+bool Timer::same_state(const Timer &other) const {
+	return div_start == other.div_start && tima == other.tima && tima_time == other.tima_time &&
+	       tma == other.tma && tac == other.tac;
+}
@@ -0,0 +1,77 @@
+#include "../include/trace.hpp"
+
+#ifdef ENABLE_TRACE
+
+#include <string.h>
+#include <chrono>
+#include <iostream>
+
+Tracer::Tracer() : head(0), tail(0), cached_tail(0), current(nullptr), file(nullptr), running(false) {
+    ring = new TraceRecord[CAPACITY];
+    records = 0;
+    stalls = 0;
+}
+
+Tracer::~Tracer() {
+    stop();
+    delete[] ring;
+}
+
+bool Tracer::start(const std::string &path) {
+    stop();
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Error: Failed to open trace file " << path << std::endl;
+        return false;
+    }
+    TraceHeader header;
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.record_size = sizeof(TraceRecord);
+    fwrite(&header, sizeof(header), 1, file);
+
+    running.store(true, std::memory_order_release);
+    writer = std::thread(&Tracer::write_loop, this);
+    return true;
+}
+
+void Tracer::stop() {
+    if (!file) {
+        return;
+    }
+    // The writer drains whatever is left once it sees this
+    running.store(false, std::memory_order_release);
+    writer.join();
+    fclose(file);
+    file = nullptr;
+}
+
+// Writer thread: save the filled part of the ring, a contiguous run of
+// records at a time, until stopped and empty
+void Tracer::write_loop() {
+    uint64_t t = tail.load(std::memory_order_relaxed);
+    while (true) {
+        // Check for stop before looking at head, so that the records
+        // published before stop() are always seen
+        bool stopping = !running.load(std::memory_order_acquire);
+        uint64_t h = head.load(std::memory_order_acquire);
+        if (h == t) {
+            if (stopping) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        uint64_t start = t & (CAPACITY - 1);
+        uint64_t count = h - t;
+        if (count > CAPACITY - start) {
+            count = CAPACITY - start; // up to the end of the ring
+        }
+        fwrite(&ring[start], sizeof(TraceRecord), count, file);
+        t += count;
+        tail.store(t, std::memory_order_release);
+    }
+    fflush(file);
+}
+
+#endif // ENABLE_TRACE